@@ -0,0 +1,1040 @@
+#include "tinyECS/tiny_ecs.hpp"
+#include "tinyECS/tiny_ecs_spatial.hpp"
+#include "tinyECS/tiny_ecs_archetype.hpp"
+#include "tinyECS/tiny_ecs_simd.hpp"
+#include "tinyECS/tiny_ecs_trace.hpp"
+#include "tinyECS/tiny_ecs_mapped.hpp"
+#include "tinyECS/tiny_ecs_history.hpp"
+#include "tinyECS/tiny_ecs_double_buffer.hpp"
+#include "tinyECS/tiny_ecs_concurrent.hpp"
+#include "tinyECS/tiny_ecs_events.hpp"
+#include "tinyECS/tiny_ecs_sliced.hpp"
+#include "tinyECS/tiny_ecs_paged.hpp"
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <string>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+// Benchmarks of the optional tinyECS storages and algorithms
+// Run all with 'ecs_bench' or a single one with 'ecs_bench <name>', e.g., 'ecs_bench spatial'
+
+struct Position {
+	float x, y;
+};
+
+struct Velocity {
+	float x, y;
+};
+
+struct Health {
+	float hit_points;
+};
+
+struct Frozen {
+	int frames_left;
+};
+
+struct Walks {
+	float walk_speed = 2;
+};
+
+// Cache line aligned storage for the components processed by the batch kernels, large position arrays use huge pages
+template<> struct ComponentStorage<Position> { static const size_t alignment = 64; static const bool huge_pages = true; };
+template<> struct ComponentStorage<Velocity> { static const size_t alignment = 64; static const bool huge_pages = false; };
+template<> struct ComponentStorage<Walks> { static const size_t alignment = 64; static const bool huge_pages = false; };
+
+// Measures the wall time of f in milliseconds
+template<typename F>
+double time_ms(F f)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+	f();
+	auto end = std::chrono::high_resolution_clock::now();
+	return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+/////////////////////////////////////////
+// Spatial queries, uniform grid and AABB tree against a linear scan of the container
+void bench_spatial(size_t count)
+{
+	const int query_count = 1000;
+	const float radius = 10;
+	// The world grows with the entity count to keep the density constant
+	const float world_size = 1000.f * std::sqrt(count / 1e5f);
+
+	std::mt19937 rng(42);
+	std::uniform_real_distribution<float> coordinate(0, world_size);
+	ComponentContainer<Position> positions;
+	positions.components.reserve(count);
+	positions.entities.reserve(count);
+	for (size_t i = 0; i < count; i++)
+		positions.insert(Entity(), Position{ coordinate(rng), coordinate(rng) });
+
+	std::vector<Position> queries(query_count);
+	for (Position& q : queries)
+		q = Position{ coordinate(rng), coordinate(rng) };
+
+	size_t found_brute = 0, found_grid = 0, found_tree = 0;
+	double brute_ms = time_ms([&]() {
+		for (const Position& q : queries)
+			for (const Position& p : positions.components)
+			{
+				float dx = p.x - q.x, dy = p.y - q.y;
+				if (dx * dx + dy * dy <= radius * radius)
+					found_brute++;
+			}
+	});
+
+	double grid_build_ms, tree_build_ms, grid_query_ms, tree_query_ms, grid_update_ms, tree_update_ms;
+	{
+		UniformGrid<Position>* grid = nullptr;
+		grid_build_ms = time_ms([&]() { grid = new UniformGrid<Position>(positions, &Position::x, &Position::y, 2 * radius); });
+		grid_query_ms = time_ms([&]() {
+			for (const Position& q : queries)
+				grid->each_in_radius(q.x, q.y, radius, [&](Entity) { found_grid++; });
+		});
+		grid_update_ms = time_ms([&]() {
+			for (Entity& e : positions.entities)
+				positions.patch(e, [](Position& p) { p.x += 0.5f; });
+		});
+		delete grid;
+	}
+	{
+		AABBTree<Position>* tree = nullptr;
+		tree_build_ms = time_ms([&]() { tree = new AABBTree<Position>(positions, &Position::x, &Position::y, 1.f); });
+		// Undo the movement of the grid update to query the same positions
+		for (Position& p : positions.components)
+			p.x -= 0.5f;
+		for (Entity& e : positions.entities)
+			positions.patch(e, [](Position&) {});
+		tree_query_ms = time_ms([&]() {
+			for (const Position& q : queries)
+				tree->each_in_radius(q.x, q.y, radius, [&](Entity) { found_tree++; });
+		});
+		tree_update_ms = time_ms([&]() {
+			for (Entity& e : positions.entities)
+				positions.patch(e, [](Position& p) { p.x += 0.5f; });
+		});
+		delete tree;
+	}
+
+	printf("spatial, %zu entities, %d radius queries (found %zu / %zu / %zu)\n", count, query_count, found_brute, found_grid, found_tree);
+	printf("  brute force  query %9.2f ms\n", brute_ms);
+	printf("  uniform grid query %9.2f ms, build %9.2f ms, update all %9.2f ms\n", grid_query_ms, grid_build_ms, grid_update_ms);
+	printf("  AABB tree    query %9.2f ms, build %9.2f ms, update all %9.2f ms\n", tree_query_ms, tree_build_ms, tree_update_ms);
+}
+
+/////////////////////////////////////////
+// Per-type containers (sparse sets) against archetype storage, for a wide query and for adding/removing components
+void bench_archetype(size_t count)
+{
+	const int frames = 100;
+	double view_ms, query_ms, archetype_ms, churn_containers_ms, churn_archetype_ms;
+	float checksum_containers = 0, checksum_archetype = 0;
+
+	{
+		ComponentContainer<Position> positions;
+		ComponentContainer<Velocity> velocities;
+		ComponentContainer<Health> healths;
+		ComponentContainer<Frozen> frozen;
+		std::vector<Entity> entities(count);
+		for (size_t i = 0; i < count; i++)
+		{
+			positions.insert(entities[i], Position{ (float)i, 0 });
+			if (i % 4 != 0)
+				velocities.insert(entities[i], Velocity{ 1, 2 });
+			if (i % 3 != 0)
+				healths.insert(entities[i], Health{ 100 });
+		}
+
+		view_ms = time_ms([&]() {
+			for (int frame = 0; frame < frames; frame++)
+				view(positions, velocities, healths).each([](Entity, Position& p, Velocity& v, Health& h) {
+					p.x += v.x * 0.016f;
+					p.y += v.y * h.hit_points * 0.001f;
+				});
+		});
+		for (Position& p : positions.components)
+			checksum_containers += p.y;
+		Query<Position, Velocity, Health> moving(positions, velocities, healths);
+		query_ms = time_ms([&]() {
+			for (int frame = 0; frame < frames; frame++)
+				moving.each([](Entity, Position& p, Velocity& v, Health& h) {
+					p.x += v.x * 0.016f;
+					p.y += v.y * h.hit_points * 0.001f;
+				});
+		});
+		churn_containers_ms = time_ms([&]() {
+			for (size_t i = 0; i < count; i += 10)
+				frozen.insert(entities[i], Frozen{ 10 });
+			for (size_t i = 0; i < count; i += 10)
+				frozen.remove(entities[i]);
+		});
+	}
+	{
+		ArchetypeWorld world;
+		ArchetypeContainer<Position> positions(world);
+		ArchetypeContainer<Velocity> velocities(world);
+		ArchetypeContainer<Health> healths(world);
+		ArchetypeContainer<Frozen> frozen(world);
+		std::vector<Entity> entities(count);
+		for (size_t i = 0; i < count; i++)
+		{
+			positions.insert(entities[i], Position{ (float)i, 0 });
+			if (i % 4 != 0)
+				velocities.insert(entities[i], Velocity{ 1, 2 });
+			if (i % 3 != 0)
+				healths.insert(entities[i], Health{ 100 });
+		}
+
+		archetype_ms = time_ms([&]() {
+			for (int frame = 0; frame < frames; frame++)
+				world.each<Position, Velocity, Health>([](Entity, Position& p, Velocity& v, Health& h) {
+					p.x += v.x * 0.016f;
+					p.y += v.y * h.hit_points * 0.001f;
+				});
+		});
+		churn_archetype_ms = time_ms([&]() {
+			for (size_t i = 0; i < count; i += 10)
+				frozen.insert(entities[i], Frozen{ 10 });
+			for (size_t i = 0; i < count; i += 10)
+				frozen.remove(entities[i]);
+		});
+		world.each<Position>([&](Entity, Position& p) { checksum_archetype += p.y; });
+	}
+
+	printf("archetype, %zu entities, %d frames of a 3-component query, %zu inserts and removes (checksums %g / %g)\n",
+		count, frames, count / 10, checksum_containers, checksum_archetype);
+	printf("  containers + view  query %9.2f ms, insert/remove %9.2f ms\n", view_ms, churn_containers_ms);
+	printf("  containers + Query query %9.2f ms\n", query_ms);
+	printf("  archetypes         query %9.2f ms, insert/remove %9.2f ms\n", archetype_ms, churn_archetype_ms);
+}
+
+/////////////////////////////////////////
+// Batch kernels over float fields at each supported instruction set
+void bench_simd(size_t count)
+{
+	const int repetitions = 100;
+	ComponentContainer<Position> positions;
+	ComponentContainer<Velocity> velocities;
+	ComponentContainer<Walks> walks;
+	for (size_t i = 0; i < count; i++)
+	{
+		Entity e;
+		positions.insert(e, Position{ (float)i, 0 });
+		velocities.insert(e, Velocity{ 1, -1 });
+		walks.insert(e, Walks());
+	}
+
+	// Throughput in GB/s of memory touched, loads and stores of 4 bytes per float
+	auto throughput = [](size_t floats, int accesses, double ms) { return floats * accesses * sizeof(float) * repetitions / (ms * 1e6); };
+
+	printf("simd, %zu entities, %d repetitions\n", count, repetitions);
+	SimdLevel best = simd_level();
+	for (int level = (int)SimdLevel::Scalar; level <= (int)best; level++)
+	{
+		simd_set_level((SimdLevel)level);
+		// Both containers hold the same entities in the same order, so the spans pair the components of each entity
+		TINYECS_CHECK(positions.entities == velocities.entities, "The spans of simd_integrate() must pair the same entities");
+		FloatSpan position_span = float_span(positions), velocity_span = float_span(velocities);
+		FloatSpan speed_span = float_span(walks, &Walks::walk_speed);
+		double integrate_ms = time_ms([&]() {
+			for (int r = 0; r < repetitions; r++)
+				simd_integrate(position_span, velocity_span, 0.016f);
+		});
+		double scale_ms = time_ms([&]() {
+			for (int r = 0; r < repetitions; r++)
+				simd_scale(speed_span, 1.0001f);
+		});
+		double clamp_ms = time_ms([&]() {
+			for (int r = 0; r < repetitions; r++)
+				simd_clamp(speed_span, 0.f, 3.f);
+		});
+		printf("  %-6s integrate %8.2f ms %6.1f GB/s, scale %8.2f ms %6.1f GB/s, clamp %8.2f ms %6.1f GB/s\n", simd_level_name((SimdLevel)level),
+			integrate_ms, throughput(position_span.count, 3, integrate_ms), scale_ms, throughput(speed_span.count, 2, scale_ms),
+			clamp_ms, throughput(speed_span.count, 2, clamp_ms));
+	}
+	simd_set_level(best);
+
+	// One field of a larger component is strided and processed by the scalar fallback
+	FloatSpan x_span = float_span(positions, &Position::x);
+	double strided_ms = time_ms([&]() {
+		for (int r = 0; r < repetitions; r++)
+			simd_scale(x_span, 1.0001f);
+	});
+	printf("  strided scale of Position::x %8.2f ms %6.1f GB/s\n", strided_ms, throughput(x_span.count, 2, strided_ms));
+}
+
+/////////////////////////////////////////
+// Cost of the tracing zones, compare a build with -DTINYECS_TRACE=ON against one without
+void bench_trace(size_t count)
+{
+	ComponentContainer<Position> positions;
+	std::vector<Entity> entities;
+	for (size_t i = 0; i < count; i++)
+		entities.push_back(Entity());
+	positions.components.reserve(count);
+	positions.entities.reserve(count);
+
+	double churn_ms = time_ms([&]() {
+		TINYECS_ZONE("bench_trace churn");
+		for (Entity e : entities)
+			positions.insert(e, Position{ 0, 0 });
+		for (Entity e : entities)
+			positions.remove(e);
+	});
+
+	// An empty zone measures the overhead of recording alone
+	double zone_ms = time_ms([&]() {
+		for (size_t i = 0; i < count; i++)
+		{
+			TINYECS_ZONE("empty");
+		}
+	});
+
+	// A zone reads the time stamp twice, which is most of its cost
+	uint64_t stamps = 0;
+	double stamp_ms = time_ms([&]() {
+		for (size_t i = 0; i < count; i++)
+			stamps += trace_now();
+	});
+
+	printf("trace (%s), %zu entities (checksum %llu)\n", TINYECS_TRACE ? "recorded" : "compiled out", count, (unsigned long long)(stamps & 0xff));
+	printf("  insert + remove %9.2f ms, %6.1f ns per operation\n", churn_ms, churn_ms * 1e6 / (2 * count));
+	printf("  empty zone      %9.2f ms, %6.1f ns per zone\n", zone_ms, zone_ms * 1e6 / count);
+	printf("  time stamp      %9.2f ms, %6.1f ns per read\n", stamp_ms, stamp_ms * 1e6 / count);
+}
+
+/////////////////////////////////////////
+// Loading a saved world, re-inserting every component against mapping the pools in place
+void bench_mapped(size_t count)
+{
+	const char* path = "ecs_bench_world.tecs";
+	{
+		ComponentContainer<Position> positions;
+		ComponentContainer<Velocity> velocities;
+		for (size_t i = 0; i < count; i++)
+		{
+			Entity e;
+			positions.insert(e, Position{ (float)i, 0 });
+			velocities.insert(e, Velocity{ 1, -1 });
+		}
+		MappedWorldWriter writer;
+		writer.add(positions);
+		writer.add(velocities);
+		if (!writer.write(path))
+		{
+			printf("mapped, can't write %s\n", path);
+			return;
+		}
+	}
+
+	// Re-inserting reads the mapped arrays too, such that both variants read the same file
+	float checksum_inserted = 0, checksum_mapped = 0;
+	double insert_ms = time_ms([&]() {
+		MappedWorld world;
+		world.open(path);
+		MappedContainer<Position> mapped_positions(world, 0);
+		MappedContainer<Velocity> mapped_velocities(world, 1);
+		ComponentContainer<Position> positions;
+		ComponentContainer<Velocity> velocities;
+		for (size_t i = 0; i < mapped_positions.size(); i++)
+			positions.insert(mapped_positions.entities[i], mapped_positions.components[i]);
+		for (size_t i = 0; i < mapped_velocities.size(); i++)
+			velocities.insert(mapped_velocities.entities[i], mapped_velocities.components[i]);
+		checksum_inserted = positions.get(positions.entities[count / 2]).x;
+	});
+	double map_ms = time_ms([&]() {
+		MappedWorld world;
+		world.open(path);
+		MappedContainer<Position> positions(world, 0);
+		MappedContainer<Velocity> velocities(world, 1);
+		checksum_mapped = positions.get(positions.entities[count / 2]).x;
+	});
+	remove(path);
+
+	printf("mapped, %zu entities with 2 components (checksums %g / %g)\n", count, checksum_inserted, checksum_mapped);
+	printf("  load by insert %9.2f ms\n", insert_ms);
+	printf("  load by mmap   %9.2f ms\n", map_ms);
+}
+
+/////////////////////////////////////////
+// Rollback, one second at 60 Hz with an 8 tick history, chunked captures against copying all containers every tick
+void bench_history(size_t count)
+{
+	const int ticks = 60;
+	const size_t window = 8;
+	std::mt19937 rng(42);
+	ComponentContainer<Position> positions;
+	ComponentContainer<Velocity> velocities;
+	ComponentContainer<Health> healths;
+	std::vector<Entity> entities;
+	for (size_t i = 0; i < count; i++)
+	{
+		Entity e;
+		entities.push_back(e);
+		positions.insert(e, Position{ (float)i, 0 });
+		velocities.insert(e, Velocity{ 1, -1 });
+		healths.insert(e, Health{ 100 });
+	}
+
+	// Every tick, 1% of the entities move and take damage and 0.1% despawn and respawn
+	auto simulate = [&](int tick) {
+		std::uniform_int_distribution<size_t> pick(0, entities.size() - 1);
+		for (size_t i = 0; i < count / 100; i++)
+		{
+			Entity e = entities[pick(rng)];
+			if (positions.has(e))
+				positions.patch(e, [&](Position& p) { Velocity& v = velocities.get(e); p.x += v.x; p.y += v.y; });
+			if (healths.has(e))
+				healths.patch(e, [](Health& h) { h.hit_points -= 1; });
+		}
+		for (size_t i = 0; i < count / 1000; i++)
+		{
+			size_t index = pick(rng);
+			positions.remove(entities[index]);
+			velocities.remove(entities[index]);
+			healths.remove(entities[index]);
+			Entity e;
+			entities[index] = e;
+			positions.insert(e, Position{ (float)tick, 0 });
+			velocities.insert(e, Velocity{ 1, -1 });
+			healths.insert(e, Health{ 100 });
+		}
+	};
+
+	History history(window);
+	history.track(positions);
+	history.track(velocities);
+	history.track(healths);
+	history.capture();
+	double simulate_ms = 0, capture_ms = 0, rewind_ms = 0;
+	for (int tick = 1; tick <= ticks; tick++)
+	{
+		simulate_ms += time_ms([&]() { simulate(tick); });
+		capture_ms += time_ms([&]() { history.capture(); });
+		// A late input arrives every 10 ticks, rewind the whole window and resimulate
+		if (tick % 10 == 0)
+		{
+			rewind_ms += time_ms([&]() { history.rewind(window - 1); });
+			for (size_t r = 0; r + 1 < window; r++)
+			{
+				simulate(tick);
+				capture_ms += time_ms([&]() { history.capture(); });
+			}
+		}
+	}
+	size_t history_bytes = history.bytes();
+
+	// Full copies of all containers every tick
+	std::vector<ComponentContainer<Position>> position_copies(window);
+	std::vector<ComponentContainer<Velocity>> velocity_copies(window);
+	std::vector<ComponentContainer<Health>> health_copies(window);
+	double copy_ms = time_ms([&]() {
+		for (int tick = 0; tick < ticks; tick++)
+		{
+			position_copies[tick % window] = positions;
+			velocity_copies[tick % window] = velocities;
+			health_copies[tick % window] = healths;
+		}
+	});
+
+	printf("history, %zu entities, %d ticks at 60 Hz, %zu tick window, %.1f MB of captures\n", count, ticks, window, history_bytes / 1e6);
+	printf("  simulate    %8.3f ms per tick\n", simulate_ms / ticks);
+	printf("  capture     %8.3f ms per capture, chunked\n", capture_ms / (ticks + ticks / 10 * (window - 1)));
+	printf("  full copy   %8.3f ms per tick\n", copy_ms / ticks);
+	printf("  rewind      %8.3f ms per %zu tick rewind\n", rewind_ms / (ticks / 10), window - 1);
+}
+
+/////////////////////////////////////////
+// A system reading the positions of frame N while another one writes frame N + 1, one after the other and at the same time
+void bench_double_buffer(size_t count)
+{
+	const int frames = 20;
+	ComponentContainer<Position> positions;
+	ComponentContainer<Velocity> velocities;
+	for (size_t i = 0; i < count; i++)
+	{
+		Entity e;
+		positions.insert(e, Position{ (float)i, 0 });
+		velocities.insert(e, Velocity{ 1, -1 }); // the same order as the positions
+	}
+	DoubleBuffer<Position> buffer(positions);
+
+	// Counts the positions in the upper half plane, e.g., a visibility test
+	size_t visible = 0;
+	auto read_system = [&]() {
+		size_t result = 0;
+		for (size_t i = 0; i < buffer.size(); i++)
+		{
+			const Position& p = buffer.read(i);
+			result += std::sqrt(p.x * p.x + p.y * p.y) > 0 && p.y >= -p.x;
+		}
+		visible += result;
+	};
+	auto write_system = [&]() {
+		for (size_t i = 0; i < buffer.size(); i++)
+		{
+			Position& p = buffer.write(i);
+			p.x += velocities.components[i].x * 0.016f;
+			p.y += velocities.components[i].y * 0.016f;
+		}
+	};
+
+	double sequential_ms = time_ms([&]() {
+		for (int frame = 0; frame < frames; frame++)
+		{
+			read_system();
+			write_system();
+			buffer.swap();
+		}
+	});
+	double concurrent_ms = time_ms([&]() {
+		for (int frame = 0; frame < frames; frame++)
+		{
+			std::thread reader(read_system);
+			write_system();
+			reader.join();
+			buffer.swap();
+		}
+	});
+
+	printf("double buffer, %zu entities, %d frames (checksum %zu)\n", count, frames, visible);
+	printf("  read + write one after the other %8.2f ms per frame\n", sequential_ms / frames);
+	printf("  read + write at the same time    %8.2f ms per frame\n", concurrent_ms / frames);
+}
+
+/////////////////////////////////////////
+// Concurrent inserts and per-thread staging from 1 to 64 threads, checked against the inserted entities
+// Returns false if any check failed, such that the bench exits with an error
+// Every component holds the id of its entity, each entity once
+bool check_concurrent_inserts(ComponentContainer<Frozen>& frozen, size_t count)
+{
+	if (frozen.size() != count)
+		return false;
+	for (size_t i = 0; i < frozen.size(); i++)
+		if (frozen.components[i].frames_left != (int)(unsigned int)frozen.entities[i] || &frozen.get(frozen.entities[i]) != &frozen.components[i])
+			return false;
+	return true;
+}
+
+// Calls f(t, begin, end) in 'threads' threads, each with its share of count
+template <typename F>
+void run_threads(size_t threads, size_t count, F f)
+{
+	std::vector<std::thread> workers;
+	for (size_t t = 0; t < threads; t++)
+		workers.emplace_back([&, t]() { f(t, count * t / threads, count * (t + 1) / threads); });
+	for (std::thread& worker : workers)
+		worker.join();
+}
+
+// Looks up earlier spawns of each thread while the other threads keep inserting, untimed
+bool check_concurrent_lookups(size_t threads, size_t count)
+{
+	ComponentContainer<Frozen> frozen;
+	std::vector<size_t> failed(threads, 0);
+	{
+		ConcurrentInserter<Frozen> inserter(frozen, count);
+		run_threads(threads, count, [&](size_t t, size_t begin, size_t end) {
+			std::vector<Entity> spawned;
+			for (size_t i = begin; i < end; i++)
+			{
+				Entity e;
+				inserter.insert(e, Frozen{ (int)(unsigned int)e });
+				spawned.push_back(e);
+				// Every 16th insert looks up an earlier spawn of this thread
+				if (i % 16 == 0)
+				{
+					Entity earlier = spawned[spawned.size() / 2];
+					Frozen* component = inserter.try_get(earlier);
+					failed[t] += !component || component->frames_left != (int)(unsigned int)earlier;
+				}
+			}
+		});
+	}
+	for (size_t f : failed)
+		if (f)
+			return false;
+	return check_concurrent_inserts(frozen, count);
+}
+
+bool bench_concurrent(size_t count)
+{
+	bool all_correct = true;
+	double single_ms = time_ms([&]() {
+		ComponentContainer<Frozen> frozen;
+		for (size_t i = 0; i < count; i++)
+		{
+			Entity e;
+			frozen.insert(e, Frozen{ (int)(unsigned int)e });
+		}
+	});
+	printf("concurrent insert, %zu entities, %u hardware threads\n", count, std::thread::hardware_concurrency());
+	printf("  insert()               %9.2f ms\n", single_ms);
+
+	// Only the inserts are timed, the threads create the entities like spawn systems
+	for (size_t threads = 1; threads <= 64; threads *= 2)
+	{
+		ComponentContainer<Frozen> frozen;
+		double finish_ms = 0;
+		double insert_ms = time_ms([&]() {
+			ConcurrentInserter<Frozen> inserter(frozen, count);
+			run_threads(threads, count, [&](size_t, size_t begin, size_t end) {
+				for (size_t i = begin; i < end; i++)
+				{
+					Entity e;
+					inserter.insert(e, Frozen{ (int)(unsigned int)e });
+				}
+			});
+			finish_ms = time_ms([&]() { inserter.finish(); });
+		});
+		bool correct = check_concurrent_inserts(frozen, count);
+
+		// The same spawns into per-thread staging containers, merged at the end
+		ComponentContainer<Frozen> merged;
+		double merge_ms = 0;
+		double staging_ms = time_ms([&]() {
+			StagingContainers<Frozen> staging(threads);
+			run_threads(threads, count, [&](size_t t, size_t begin, size_t end) {
+				for (size_t i = begin; i < end; i++)
+				{
+					Entity e;
+					staging[t].insert(e, Frozen{ (int)(unsigned int)e });
+				}
+			});
+			merge_ms = time_ms([&]() { staging.merge_into(merged); });
+		});
+		bool staging_correct = check_concurrent_inserts(merged, count);
+
+		printf("  %2zu threads, inserter %9.2f ms, of which finish() %7.2f ms, %s; staging %9.2f ms, of which merge %7.2f ms, %s\n",
+			threads, insert_ms, finish_ms, correct ? "correct" : "WRONG", staging_ms, merge_ms, staging_correct ? "correct" : "WRONG");
+		all_correct &= correct && staging_correct;
+	}
+
+	bool lookups_correct = check_concurrent_lookups(8, count);
+	printf("  try_get() while 8 threads insert: %s\n", lookups_correct ? "correct" : "WRONG");
+	return all_correct && lookups_correct;
+}
+
+/////////////////////////////////////////
+// One frame events, a ComponentContainer that is cleared every frame against an EventStream
+struct Damage {
+	float amount;
+};
+
+void bench_events(size_t count)
+{
+	const int frames = 20;
+	ComponentContainer<Health> healths;
+	std::vector<Entity> targets;
+	for (size_t i = 0; i < count; i++)
+	{
+		Entity e;
+		targets.push_back(e);
+		healths.insert(e, Health{ 100 });
+	}
+
+	// Every frame, each entity takes damage once, a health system and a statistics system consume the events
+	double total_container = 0, total_stream = 0;
+	ComponentContainer<Damage> damage_components;
+	double container_ms = time_ms([&]() {
+		for (int frame = 0; frame < frames; frame++)
+		{
+			for (Entity e : targets)
+				damage_components.insert(e, Damage{ 1 });
+			view(damage_components, healths).each([](Entity, Damage& damage, Health& health) { health.hit_points -= damage.amount; });
+			for (Damage& damage : damage_components.components)
+				total_container += damage.amount;
+			damage_components.clear();
+		}
+	});
+
+	// The producing system appends through an EventWriter, or with one atomic increment per push()
+	EventStream<Damage> damage_events;
+	EventCursor health_cursor, statistics_cursor;
+	auto health_view = view(healths);
+	auto stream_frames = [&](bool writer_batches) {
+		return time_ms([&]() {
+			for (int frame = 0; frame < frames; frame++)
+			{
+				if (writer_batches)
+				{
+					EventWriter<Damage> writer(damage_events);
+					for (Entity e : targets)
+						writer.push(e, Damage{ 1 });
+				}
+				else
+				{
+					for (Entity e : targets)
+						damage_events.push(e, Damage{ 1 });
+				}
+				damage_events.read(health_cursor, [&](Entity e, const Damage& damage) {
+					health_view.visit(e, [&](Entity, Health& health) { health.hit_points -= damage.amount; });
+				});
+				damage_events.read(statistics_cursor, [&](Entity, const Damage& damage) { total_stream += damage.amount; });
+				damage_events.reset();
+			}
+		});
+	};
+	double writer_ms = stream_frames(true);
+	double push_ms = stream_frames(false);
+
+	printf("events, %zu events per frame, %d frames (checksums %g / %g)\n", count, frames, total_container, total_stream / 2);
+	printf("  ComponentContainer + clear()    %8.2f ms per frame\n", container_ms / frames);
+	printf("  EventStream, EventWriter        %8.2f ms per frame\n", writer_ms / frames);
+	printf("  EventStream, push() per event   %8.2f ms per frame\n", push_ms / frames);
+}
+
+/////////////////////////////////////////
+// Skipping inactive entities, disabled components against an exclusion tag and a flag tested per entity
+struct Asleep {
+};
+
+void bench_disable(size_t count)
+{
+	const int frames = 20;
+	ComponentContainer<Position> positions;
+	ComponentContainer<Velocity> velocities;
+	ComponentContainer<Asleep> asleep;
+	std::vector<Entity> entities;
+	for (size_t i = 0; i < count; i++)
+	{
+		Entity e;
+		entities.push_back(e);
+		positions.insert(e, Position{ (float)i, 0 });
+		velocities.insert(e, Velocity{ 1, -1 });
+	}
+
+	// Nine out of ten entities are inactive, e.g., far away from the camera
+	std::mt19937 rng(7);
+	std::vector<char> active(count);
+	for (size_t i = 0; i < count; i++)
+		active[i] = rng() % 10 == 0;
+	auto move = [](Entity, Position& p, Velocity& v) {
+		p.x += v.x * 0.016f;
+		p.y += v.y * 0.016f;
+	};
+
+	for (size_t i = 0; i < count; i++)
+		if (!active[i])
+			asleep.insert(entities[i], Asleep());
+	double exclude_ms = time_ms([&]() {
+		for (int frame = 0; frame < frames; frame++)
+			view(positions, velocities).exclude(asleep).each(move);
+	});
+	asleep.clear();
+
+	// The flag is looked up in a parallel array, the cheapest per-entity test
+	double flag_ms = time_ms([&]() {
+		for (int frame = 0; frame < frames; frame++)
+			for (size_t i = 0; i < positions.size(); i++)
+				if (active[(unsigned int)positions.entities[i] - (unsigned int)entities[0]])
+					move(positions.entities[i], positions.components[i], velocities.get(positions.entities[i]));
+	});
+
+	double toggle_ms = time_ms([&]() {
+		for (size_t i = 0; i < count; i++)
+			if (!active[i])
+			{
+				positions.disable(entities[i]);
+				velocities.disable(entities[i]);
+			}
+	});
+	double disabled_ms = time_ms([&]() {
+		for (int frame = 0; frame < frames; frame++)
+			view(positions, velocities).each(move);
+	});
+
+	printf("disable, %zu entities, %zu active, %d frames\n", count, positions.enabled_count, frames);
+	printf("  view excluding a tag     %8.2f ms per frame\n", exclude_ms / frames);
+	printf("  flag tested per entity   %8.2f ms per frame\n", flag_ms / frames);
+	printf("  view of enabled entities %8.2f ms per frame\n", disabled_ms / frames);
+	printf("  disabling the inactive   %8.2f ms, %.1f ns per entity\n", toggle_ms, toggle_ms * 1e6 / (2 * (count - positions.enabled_count)));
+}
+
+/////////////////////////////////////////
+// Time-sliced iteration, an expensive system spread over frames within a budget, while entities spawn and despawn
+void bench_sliced(size_t count)
+{
+	const int frames = 200;
+	const double budget_ms = 1;
+	ComponentContainer<Position> positions;
+	std::vector<Entity> entities;
+	for (size_t i = 0; i < count; i++)
+	{
+		entities.push_back(Entity());
+		positions.insert(entities.back(), Position{ (float)i, 0 });
+	}
+
+	// A stand-in for replanning, a few hundred nanoseconds per entity
+	float checksum = 0;
+	auto replan = [&](Entity, Position& p) {
+		float x = p.x;
+		for (int k = 0; k < 100; k++)
+			x = x * 0.999f + 0.5f;
+		p.y = x;
+		checksum += x;
+	};
+	double full_ms = time_ms([&]() { view(positions).each(replan); });
+
+	SlicedCursor<Position> cursor(positions);
+	std::mt19937 rng(11);
+	double slowest_ms = 0, total_ms = 0;
+	for (int frame = 0; frame < frames; frame++)
+	{
+		// Despawn and spawn between the slices, the cursor keeps track of the moved components
+		for (int k = 0; k < 100; k++)
+		{
+			size_t victim = rng() % entities.size();
+			positions.remove(entities[victim]);
+			entities[victim] = Entity();
+			positions.insert(entities[victim], Position{ (float)k, 0 });
+		}
+		double ms = time_ms([&]() { cursor.each_for(budget_ms, replan); });
+		slowest_ms = std::max(slowest_ms, ms);
+		total_ms += ms;
+	}
+
+	double passes = cursor.passes + 1 - (double)cursor.remaining() / positions.size();
+	printf("sliced, %zu entities, %d frames (checksum %g)\n", count, frames, checksum);
+	printf("  all entities in one frame      %8.2f ms\n", full_ms);
+	printf("  budget of %.1f ms per frame     %8.2f ms average, %.2f ms slowest frame\n", budget_ms, total_ms / frames, slowest_ms);
+	printf("  frames per pass                %8.1f\n", frames / passes);
+}
+
+/////////////////////////////////////////
+// Level of detail, near entities updated every frame and far ones every 4th or 16th frame, against updating all of them
+void bench_lod(size_t count)
+{
+	const int frames = 64;
+	ComponentContainer<Position> positions;
+	ComponentContainer<Velocity> velocities;
+	positions.set_tiers({ 1, 4, 16 });
+	std::vector<Entity> entities;
+	for (size_t i = 0; i < count; i++)
+	{
+		entities.push_back(Entity());
+		positions.insert(entities.back(), Position{ (float)i, 0 });
+		velocities.insert(entities.back(), Velocity{ 1, -1 });
+	}
+
+	// 10% near, 30% at medium distance, the rest far away
+	std::mt19937 rng(13);
+	auto tier_by_distance = [&]() { size_t d = rng() % 10; return d < 1 ? 0 : d < 4 ? 1 : 2; };
+	double assign_ms = time_ms([&]() {
+		for (Entity e : entities)
+			positions.set_tier(e, tier_by_distance());
+	});
+
+	auto move = [](Entity, Position& p, Velocity& v) {
+		p.x += v.x * 0.016f;
+		p.y += v.y * 0.016f;
+	};
+	double all_ms = time_ms([&]() {
+		for (int frame = 0; frame < frames; frame++)
+			view(positions, velocities).each(move);
+	});
+	double due_ms = time_ms([&]() {
+		for (int frame = 0; frame < frames; frame++)
+			view(positions, velocities).due(frame).each(move); // a real system scales the time step by the tier interval
+	});
+
+	// 1% of the entities change their distance tier every frame
+	double retier_ms = time_ms([&]() {
+		for (int frame = 0; frame < frames; frame++)
+			for (size_t k = 0; k < count / 100; k++)
+				positions.set_tier(entities[rng() % count], tier_by_distance());
+	});
+
+	printf("lod, %zu entities, tiers [0, %zu) [%zu, %zu) [%zu, %zu) every 1, 4, 16 frames\n", count,
+		positions.tier_end(0), positions.tier_begin(1), positions.tier_end(1), positions.tier_begin(2), positions.tier_end(2));
+	printf("  all entities every frame %8.2f ms per frame\n", all_ms / frames);
+	printf("  due tiers every frame    %8.2f ms per frame\n", due_ms / frames);
+	printf("  retiering 1%% per frame   %8.2f ms per frame, initial assignment %.2f ms\n", retier_ms / frames, assign_ms);
+}
+
+/////////////////////////////////////////
+// Lookups by entity, the paged sparse index of ComponentContainer against the hash map it replaced
+void bench_lookup(size_t count)
+{
+	ComponentContainer<Health> healths;
+	std::unordered_map<unsigned int, unsigned int> hash_index;
+	std::vector<Entity> entities;
+	for (size_t i = 0; i < count; i++)
+	{
+		entities.push_back(Entity());
+		healths.insert(entities.back(), Health{ (float)i });
+		hash_index[entities.back()] = (unsigned int)i;
+	}
+	std::mt19937 rng(17);
+	std::shuffle(entities.begin(), entities.end(), rng);
+
+	float checksum = 0;
+	double hash_ms = time_ms([&]() {
+		for (Entity e : entities)
+			checksum += healths.components[hash_index.find(e)->second].hit_points;
+	});
+	double get_ms = time_ms([&]() {
+		for (Entity e : entities)
+			checksum += healths.get(e).hit_points;
+	});
+	double try_get_ms = time_ms([&]() {
+		for (Entity e : entities)
+			if (Health* health = healths.try_get(e))
+				checksum += health->hit_points;
+	});
+
+	// Half of the handles are stale, their components were removed
+	for (size_t i = 0; i < count / 2; i++)
+		healths.remove(entities[i]);
+	size_t found = 0;
+	double stale_ms = time_ms([&]() {
+		for (Entity e : entities)
+			found += healths.try_get(e) != nullptr;
+	});
+
+	printf("lookup, %zu entities in random order (checksum %g)\n", count, checksum);
+	printf("  hash map find          %8.2f ns per lookup\n", hash_ms * 1e6 / count);
+	printf("  get()                  %8.2f ns per lookup, checked\n", get_ms * 1e6 / count);
+	printf("  try_get()              %8.2f ns per lookup\n", try_get_ms * 1e6 / count);
+	printf("  try_get(), half stale  %8.2f ns per lookup, %zu found\n", stale_ms * 1e6 / count, found);
+	printf("  index memory           %8.2f MB, hash map %.2f MB\n", healths.stats().index_bytes / 1e6, unordered_map_bytes(hash_index) / 1e6);
+}
+
+/////////////////////////////////////////
+// Out-of-core paging, a world four times larger than the memory budget with a small set of active entities
+struct Dormant {
+	float state[16];
+};
+
+void bench_paged(size_t count)
+{
+	const size_t budget = count * sizeof(Dormant) / 4;
+	PagedContainer<Dormant> dormants("ecs_bench_paged.swap", budget);
+	std::vector<Entity> entities;
+	double insert_ms = time_ms([&]() {
+		for (size_t i = 0; i < count; i++)
+		{
+			entities.push_back(Entity());
+			Dormant d = {};
+			d.state[0] = (float)i;
+			dormants.insert(entities.back(), d);
+		}
+	});
+	PagingStats after_insert = dormants.paging_stats();
+
+	// 90% of the accesses go to the 5% of the entities around the players
+	std::mt19937 rng(19);
+	const size_t accesses = 1000000;
+	size_t active = count / 20;
+	double access_ms = time_ms([&]() {
+		for (size_t k = 0; k < accesses; k++)
+		{
+			size_t i = rng() % 10 != 0 ? rng() % active : rng() % count;
+			dormants.get(entities[i]).state[1] += 1;
+		}
+	});
+	PagingStats after_access = dormants.paging_stats();
+
+	// A pass over the whole world, e.g., to save it, reads every chunk once
+	double sum = 0;
+	double scan_ms = time_ms([&]() {
+		dormants.each_const([&](Entity, const Dormant& d) { sum += d.state[0]; });
+	});
+	PagingStats after_scan = dormants.paging_stats();
+
+	printf("paged, %zu entities, %.1f MB of components, %.1f MB budget (checksum %g)\n", count,
+		count * sizeof(Dormant) / 1e6, budget / 1e6, sum);
+	printf("  insert              %8.2f ms, %zu chunks written\n", insert_ms, after_insert.writes);
+	printf("  get(), 90%% hot      %8.2f ns per access, %.2f%% faults\n", access_ms * 1e6 / accesses,
+		100.0 * (after_access.faults - after_insert.faults) / accesses);
+	printf("  each_const() pass   %8.2f ms, %zu faults\n", scan_ms, after_scan.faults - after_access.faults);
+	printf("  resident            %8.2f MB of %zu chunks\n", dormants.resident_bytes() / 1e6, after_scan.chunks);
+}
+
+/////////////////////////////////////////
+// Entry point
+int main(int argc, char* argv[])
+{
+	const char* only = argc > 1 ? argv[1] : nullptr;
+	auto selected = [only](const char* name) { return !only || strcmp(only, name) == 0; };
+	bool correct = true; // benches that check their results clear it on a wrong result
+
+	if (selected("spatial"))
+	{
+		bench_spatial(100000);
+		bench_spatial(1000000);
+	}
+	if (selected("archetype"))
+	{
+		bench_archetype(100000);
+		bench_archetype(1000000);
+	}
+	if (selected("simd"))
+	{
+		bench_simd(100000);
+		bench_simd(1000000);
+	}
+	if (selected("mapped"))
+	{
+		bench_mapped(100000);
+		bench_mapped(1000000);
+	}
+	if (selected("history"))
+	{
+		bench_history(100000);
+	}
+	if (selected("double_buffer"))
+	{
+		bench_double_buffer(100000);
+		bench_double_buffer(1000000);
+	}
+	if (selected("concurrent"))
+	{
+		correct &= bench_concurrent(100000);
+		correct &= bench_concurrent(1000000);
+	}
+	if (selected("events"))
+	{
+		bench_events(10000);
+		bench_events(1000000);
+	}
+	if (selected("disable"))
+	{
+		bench_disable(100000);
+		bench_disable(1000000);
+	}
+	if (selected("sliced"))
+	{
+		bench_sliced(100000);
+		bench_sliced(1000000);
+	}
+	if (selected("lod"))
+	{
+		bench_lod(100000);
+		bench_lod(1000000);
+	}
+	if (selected("lookup"))
+	{
+		bench_lookup(100000);
+		bench_lookup(1000000);
+	}
+	if (selected("paged"))
+	{
+		bench_paged(100000);
+		bench_paged(1000000);
+	}
+	if (selected("trace"))
+	{
+		bench_trace(100000);
+		bench_trace(1000000);
+		if (TINYECS_TRACE && trace_export_chrome("ecs_bench_trace.json"))
+			printf("  zones written to ecs_bench_trace.json\n");
+	}
+	return correct ? EXIT_SUCCESS : EXIT_FAILURE;
+}
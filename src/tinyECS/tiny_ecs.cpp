@@ -1,5 +1,127 @@
-// internal
-#include "tiny_ecs.hpp"
-
-// All we need to store besides the containers is the id of every entity
-unsigned int Entity::id_count = 1;
\ No newline at end of file
+// internal
+#include "tiny_ecs.hpp"
+#include <deque>
+#include <typeinfo>
+#include <cstdio>
+#include <new>
+#include <cstdlib>
+#include <cstdint>
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+// All we need to store besides the containers is the id of every entity
+std::atomic<unsigned int> Entity::id_count(1);
+
+// The constants of the sparse index, defined once for the lookups that take their address
+const unsigned int SparseIndex::page_bits;
+const unsigned int SparseIndex::page_size;
+const unsigned int SparseIndex::empty;
+
+// The global string table of InternedString, a deque keeps the strings at fixed addresses while it grows
+static std::deque<std::string>& interned_strings()
+{
+    static std::deque<std::string> strings(1); // id 0 is the empty string
+    return strings;
+}
+
+// The lookup from string -> id, used to find existing strings when interning
+static std::unordered_map<std::string, unsigned int>& interned_ids()
+{
+    static std::unordered_map<std::string, unsigned int> ids = { { std::string(), 0 } };
+    return ids;
+}
+
+InternedString::InternedString(const std::string& str)
+{
+    auto result = interned_ids().emplace(str, (unsigned int)interned_strings().size());
+    if (result.second)
+        interned_strings().push_back(str);
+    id = result.first->second;
+}
+
+InternedString::InternedString(const char* str) : InternedString(std::string(str))
+{
+}
+
+bool InternedString::find(const std::string& str, InternedString& result)
+{
+    auto it = interned_ids().find(str);
+    if (it == interned_ids().end())
+        return false;
+    result.id = it->second;
+    return true;
+}
+
+const std::string& InternedString::str() const
+{
+    return interned_strings()[id];
+}
+
+// Blocks with huge pages are aligned to the huge page size of x86 and ARM
+static const size_t huge_page_size = 2 * 1024 * 1024;
+
+void* aligned_allocate(size_t bytes, size_t alignment, bool huge_pages)
+{
+#ifdef __linux__
+    if (huge_pages && bytes >= huge_page_size)
+    {
+        void* block = nullptr;
+        size_t rounded = (bytes + huge_page_size - 1) / huge_page_size * huge_page_size;
+        if (posix_memalign(&block, huge_page_size, rounded) != 0)
+            throw std::bad_alloc();
+        madvise(block, rounded, MADV_HUGEPAGE); // only a hint, fails silently without transparent huge pages
+        return block;
+    }
+#endif
+    if (alignment <= alignof(std::max_align_t))
+        return ::operator new(bytes);
+
+    // Over-allocate and store the address of the allocation in front of the aligned block
+    char* raw = static_cast<char*>(::operator new(bytes + alignment + sizeof(void*)));
+    uintptr_t address = reinterpret_cast<uintptr_t>(raw + sizeof(void*));
+    char* block = raw + sizeof(void*) + ((alignment - address % alignment) % alignment);
+    reinterpret_cast<void**>(block)[-1] = raw;
+    return block;
+}
+
+void aligned_free(void* block, size_t bytes, size_t alignment, bool huge_pages)
+{
+    if (!block)
+        return;
+#ifdef __linux__
+    if (huge_pages && bytes >= huge_page_size)
+    {
+        free(block);
+        return;
+    }
+#endif
+    if (alignment <= alignof(std::max_align_t))
+        ::operator delete(block);
+    else
+        ::operator delete(reinterpret_cast<void**>(block)[-1]);
+}
+
+void tinyecs_check_failed(const char* message, const char* file, int line)
+{
+    fprintf(stderr, "%s:%d: %s\n", file, line, message);
+    abort();
+}
+
+void print_container_stats(const std::vector<ContainerInterface*>& containers)
+{
+    printf("Stats of all registry entries:\n");
+    printf("%8s %12s %12s %12s %7s %8s %8s %8s %8s  %s\n", "count", "used bytes", "reserved", "index bytes", "load %", "inserts", "removes", "gets", "hases", "type");
+    ContainerStats total;
+    for (ContainerInterface* container : containers)
+    {
+        ContainerStats stats = container->stats();
+        printf("%8zu %12zu %12zu %12zu %7.1f %8zu %8zu %8zu %8zu  %s\n", stats.count, stats.bytes_used, stats.bytes_reserved,
+            stats.index_bytes, stats.load_factor * 100, stats.inserts, stats.removes, stats.gets, stats.hases, typeid(*container).name());
+        total.count += stats.count;
+        total.bytes_used += stats.bytes_used;
+        total.bytes_reserved += stats.bytes_reserved;
+        total.index_bytes += stats.index_bytes;
+    }
+    printf("%8zu %12zu %12zu %12zu  total\n", total.count, total.bytes_used, total.bytes_reserved, total.index_bytes);
+}
@@ -1,119 +1,1700 @@
-#pragma once
-
-#include <vector>
-#include <unordered_map>
-#include <assert.h>
-
-// Unique identifyer for all entities
-class Entity
-{
-    unsigned int id;
-    static unsigned int id_count; // starts from 1, entit 0 is the default initialization
-public:
-    Entity()
-    {
-        id = id_count++;
-        // Note, indices of already deleted entities arent re-used in this simple implementation.
-    }
-    operator unsigned int() { return id; } // this enables automatic casting to int
-};
-
-// Common interface to refer to all containers in the ECS registry
-struct ContainerInterface
-{
-    virtual void clear() = 0;
-    virtual size_t size() = 0;
-    virtual void remove(Entity e) = 0;
-    virtual bool has(Entity entity) = 0;
-};
-
-// A container that stores components of type 'Component' and associated entities
-template <typename Component> // A component can be any class
-class ComponentContainer : public ContainerInterface
-{
-private:
-    // The hash map from Entity -> array index.
-    std::unordered_map<unsigned int, unsigned int> map_entity_componentID; // the entity is cast to uint to be hashable.
-    bool registered = false;
-public:
-    // Container of all components of type 'Component'
-    std::vector<Component> components;
-
-    // The corresponding entities
-    std::vector<Entity> entities;
-
-    // Constructor that registers the type
-    ComponentContainer()
-    {
-    }
-
-    // Inserting a component c associated to entity e
-    inline Component& insert(Entity e, Component c, bool check_for_duplicates = true)
-    {
-        // Usually, every entity should only have one instance of each component type
-        assert(!(check_for_duplicates && has(e)) && "Entity already contained in ECS registry");
-
-
-        map_entity_componentID[e] = (unsigned int)components.size();
-        components.push_back(std::move(c)); // the move enforces move instead of copy constructor
-        entities.push_back(e);
-        return components.back();
-    };
-
-    // The emplace function takes the the provided arguments Args, creates a new object of type Component, and inserts it into the ECS system
-    template<typename... Args>
-    Component& emplace(Entity e, Args &&... args) {
-        return insert(e, Component(std::forward<Args>(args)...)); // the forward ensures that arguments are moved not copied
-    };
-    template<typename... Args>
-    Component& emplace_with_duplicates(Entity e, Args &&... args) {
-        return insert(e, Component(std::forward<Args>(args)...), false); // the forward ensures that arguments are moved not copied
-    };
-
-    // A wrapper to return the component of an entity
-    Component& get(Entity e) {
-        assert(has(e) && "Entity not contained in ECS registry");
-        return components[map_entity_componentID[e]];
-    }
-
-    // Check if entity has a component of type 'Component'
-    bool has(Entity entity) {
-        return map_entity_componentID.count(entity) > 0;
-    }
-
-    // Remove an component and pack the container to re-use the empty space
-    void remove(Entity e)
-    {
-        if (has(e))
-        {
-            // Get the current position
-            int cID = map_entity_componentID[e];
-
-            // Move the last element to position cID using the move operator
-            // Note, components[cID] = components.back() would trigger the copy instead of move operator
-            components[cID] = std::move(components.back());
-            entities[cID] = entities.back(); // the entity is only a single index, copy it.
-            map_entity_componentID[entities.back()] = cID;
-
-            // Erase the old component and free its memory
-            map_entity_componentID.erase(e);
-            components.pop_back();
-            entities.pop_back();
-            // Note, one could mark the id for re-use
-        }
-    };
-
-    // Remove all components of type 'Component'
-    void clear()
-    {
-        map_entity_componentID.clear();
-        components.clear();
-        entities.clear();
-    }
-
-    // Report the number of components of type 'Component'
-    size_t size()
-    {
-        return components.size();
-    }
-};
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+#include <functional>
+#include <string>
+#include <algorithm>
+#include <tuple>
+#include <array>
+#include <new>
+#include <utility>
+#include <type_traits>
+#include <cstddef>
+#include <atomic>
+#include <memory>
+#include <assert.h>
+
+// Unique identifyer for all entities
+class Entity
+{
+    unsigned int id;
+    static std::atomic<unsigned int> id_count; // starts from 1, entit 0 is the default initialization
+public:
+    // Entities can be created by several threads at once
+    Entity()
+    {
+        id = id_count.fetch_add(1, std::memory_order_relaxed);
+        // Note, indices of already deleted entities arent re-used in this simple implementation.
+    }
+    operator unsigned int() const { return id; } // this enables automatic casting to int
+
+    // Re-creates the handle of an existing entity from its id, e.g., for indices that store plain ids
+    static Entity from_id(unsigned int id)
+    {
+        return Entity(id, FromId());
+    }
+
+    // The id of the next created entity
+    static unsigned int next_id() { return id_count.load(std::memory_order_relaxed); }
+
+    // Skips ids up to end, e.g., after loading entities that were created elsewhere, such that new ids don't collide
+    static void reserve_ids(unsigned int end)
+    {
+        unsigned int current = id_count.load(std::memory_order_relaxed);
+        while (current < end && !id_count.compare_exchange_weak(current, end, std::memory_order_relaxed))
+            ;
+    }
+private:
+    struct FromId {};
+    Entity(unsigned int id, FromId) : id(id) {}
+};
+
+// An immutable string that is stored once in a global string table and referred to by a 32-bit id
+// Components that hold an InternedString instead of a std::string are trivially copyable, copies and
+// comparisons for equality are O(1) and never allocate. Creating one from text costs a hash lookup.
+// Note, the string table is not thread safe and strings are never freed.
+class InternedString
+{
+    unsigned int id; // index into the string table, 0 is the empty string
+public:
+    InternedString() : id(0) {}
+    InternedString(const char* str);
+    InternedString(const std::string& str);
+
+    // Returns the interned string for 'str' without adding it to the table
+    // Returns false if 'str' was never interned, i.e., no component can hold it
+    static bool find(const std::string& str, InternedString& result);
+
+    const std::string& str() const;
+    const char* c_str() const { return str().c_str(); }
+    unsigned int get_id() const { return id; }
+    bool empty() const { return id == 0; }
+
+    bool operator==(InternedString other) const { return id == other.id; }
+    bool operator!=(InternedString other) const { return id != other.id; }
+    // Alphabetical order, comparing the characters and not the ids
+    bool operator<(InternedString other) const { return id != other.id && str() < other.str(); }
+};
+static_assert(std::is_trivially_copyable<InternedString>::value, "InternedString must remain trivially copyable");
+
+namespace std
+{
+    template<> struct hash<InternedString>
+    {
+        size_t operator()(InternedString s) const { return std::hash<unsigned int>()(s.get_id()); }
+    };
+}
+
+struct ContainerInterface;
+
+// Counting the operations of every container for stats(), define TINYECS_COUNT_OPERATIONS as 0 to remove the counters
+// The counters are relaxed atomics, threads that use the same container at once may miss counts but don't race
+#ifndef TINYECS_COUNT_OPERATIONS
+#define TINYECS_COUNT_OPERATIONS 1
+#endif
+#if TINYECS_COUNT_OPERATIONS
+#define TINYECS_COUNT(counter) operation_counts.count(operation_counts.counter)
+#else
+#define TINYECS_COUNT(counter) ((void)0)
+#endif
+
+// Checks conditions whose failure would corrupt memory, e.g., that an entity handle refers to a contained component in get()
+// The checks stay in release builds, a failed check prints the message and aborts
+#define TINYECS_CHECK(condition, message) ((condition) ? (void)0 : tinyecs_check_failed(message, __FILE__, __LINE__))
+[[noreturn]] void tinyecs_check_failed(const char* message, const char* file, int line);
+
+// Tracing zones around the structural operations, define TINYECS_TRACE as 1 to record them, see tiny_ecs_trace.hpp
+#ifndef TINYECS_TRACE
+#define TINYECS_TRACE 0
+#endif
+#if TINYECS_TRACE
+#include "tiny_ecs_trace.hpp"
+#elif !defined(TINYECS_ZONE)
+#define TINYECS_ZONE(name) ((void)0)
+#endif
+
+// Memory use and operation counts of a container, see ContainerInterface::stats()
+struct ContainerStats
+{
+    size_t count = 0; // number of components
+    size_t bytes_used = 0; // bytes of the components and entities in use
+    size_t bytes_reserved = 0; // bytes allocated for components and entities, including unused capacity
+    size_t index_bytes = 0; // estimated bytes of the lookup from entity to component, e.g., hash buckets and nodes
+    size_t index_buckets = 0; // slots of the lookup, e.g., hash buckets or the slots of the allocated index pages
+    float load_factor = 0; // components per slot, for the paged index the occupancy of its allocated pages
+
+    // Operations since construction or reset_operation_counts()
+    // Note, the lookups of views, queries, and collectors count as gets and hases too
+    size_t inserts = 0;
+    size_t removes = 0;
+    size_t gets = 0;
+    size_t hases = 0;
+};
+
+// The operation counters of a container, see TINYECS_COUNT
+struct OperationCounts
+{
+    std::atomic<size_t> inserts{ 0 };
+    std::atomic<size_t> removes{ 0 };
+    std::atomic<size_t> gets{ 0 };
+    std::atomic<size_t> hases{ 0 };
+
+    OperationCounts() {}
+    OperationCounts(const OperationCounts& other) { *this = other; }
+    OperationCounts& operator=(const OperationCounts& other)
+    {
+        inserts.store(other.inserts.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        removes.store(other.removes.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        gets.store(other.gets.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        hases.store(other.hases.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        return *this;
+    }
+
+    // A load and a store instead of an atomic increment, which would make the counter a contended cache line
+    static void count(std::atomic<size_t>& counter)
+    {
+        counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    // The counts in otherwise empty stats
+    ContainerStats stats() const
+    {
+        ContainerStats result;
+        result.inserts = inserts.load(std::memory_order_relaxed);
+        result.removes = removes.load(std::memory_order_relaxed);
+        result.gets = gets.load(std::memory_order_relaxed);
+        result.hases = hases.load(std::memory_order_relaxed);
+        return result;
+    }
+};
+
+// Estimated memory of a std::unordered_map, each node stores the value and a pointer to the next node
+template <typename Map>
+size_t unordered_map_bytes(const Map& map)
+{
+    size_t node = sizeof(typename Map::value_type) + sizeof(void*);
+    node = (node + sizeof(void*) - 1) / sizeof(void*) * sizeof(void*);
+    return map.bucket_count() * sizeof(void*) + map.size() * node;
+}
+
+// Receives notifications about changes of a container, e.g., to keep an index up to date
+// The 'index' is the position of the entity in the dense arrays of the container
+struct ContainerObserver
+{
+    virtual ~ContainerObserver() {}
+    // The arguments are the container, the entity, and the index of its component in the container
+    // Called after the component of the entity was inserted
+    virtual void on_insert(ContainerInterface&, Entity, unsigned int) {}
+    // Called before the component of the entity is removed, while it is still accessible
+    virtual void on_remove(ContainerInterface&, Entity, unsigned int) {}
+    // Called after the component of the entity was changed with patch()
+    virtual void on_patch(ContainerInterface&, Entity, unsigned int) {}
+    // Called before all components are removed
+    virtual void on_clear(ContainerInterface&) {}
+    // Called after the components at two positions were exchanged, e.g., to disable one of them
+    virtual void on_swap(ContainerInterface&, unsigned int, unsigned int) {}
+};
+
+// Common interface to refer to all containers in the ECS registry
+struct ContainerInterface
+{
+    virtual ~ContainerInterface() {}
+    virtual void clear() = 0;
+    virtual size_t size() = 0;
+    virtual void remove(Entity e) = 0;
+    virtual bool has(Entity entity) = 0;
+
+    // Report the memory use and the operation counts, containers that don't track the memory only report the count
+    virtual ContainerStats stats()
+    {
+        ContainerStats result = operation_counts.stats();
+        result.count = size();
+        return result;
+    }
+
+    // Release unused memory, e.g., after many components were removed
+    virtual void shrink_to_fit()
+    {
+    }
+
+    // Keep the component of an entity but hide it from views and queries, containers without this state ignore it
+    virtual void disable(Entity)
+    {
+    }
+
+    virtual void enable(Entity)
+    {
+    }
+
+    void reset_operation_counts()
+    {
+        operation_counts = OperationCounts();
+    }
+
+    // The observers that are notified about inserted, removed, and patched components
+    std::vector<ContainerObserver*> observers;
+
+    void connect(ContainerObserver* observer)
+    {
+        observers.push_back(observer);
+    }
+
+    void disconnect(ContainerObserver* observer)
+    {
+        observers.erase(std::remove(observers.begin(), observers.end(), observer), observers.end());
+    }
+
+protected:
+    // Only the operation counters are used, see TINYECS_COUNT
+    OperationCounts operation_counts;
+
+    void notify_insert(Entity e, unsigned int index)
+    {
+        for (ContainerObserver* observer : observers)
+            observer->on_insert(*this, e, index);
+    }
+    void notify_remove(Entity e, unsigned int index)
+    {
+        for (ContainerObserver* observer : observers)
+            observer->on_remove(*this, e, index);
+    }
+    void notify_patch(Entity e, unsigned int index)
+    {
+        for (ContainerObserver* observer : observers)
+            observer->on_patch(*this, e, index);
+    }
+    void notify_clear()
+    {
+        for (ContainerObserver* observer : observers)
+            observer->on_clear(*this);
+    }
+    void notify_swap(unsigned int a, unsigned int b)
+    {
+        for (ContainerObserver* observer : observers)
+            observer->on_swap(*this, a, b);
+    }
+};
+
+// Prints the stats of all containers, one line per container and the total, e.g., for the containers of a registry
+void print_container_stats(const std::vector<ContainerInterface*>& containers);
+
+// Allocates 'bytes' aligned to 'alignment', which must be a power of two
+// With huge_pages, large blocks are aligned to 2 MiB and backed by transparent huge pages where the OS supports it
+void* aligned_allocate(size_t bytes, size_t alignment, bool huge_pages);
+// Frees a block of aligned_allocate(), the arguments must be the same as for the allocation
+void aligned_free(void* block, size_t bytes, size_t alignment, bool huge_pages);
+
+// An allocator for std::vector that aligns the array, e.g., to the cache line size for vectorized loops
+// The alignment is a property of each allocator to keep the vector type the same for all options
+template <typename T>
+struct AlignedAllocator
+{
+    typedef T value_type;
+    typedef std::true_type propagate_on_container_copy_assignment;
+    typedef std::true_type propagate_on_container_move_assignment;
+    typedef std::true_type propagate_on_container_swap;
+
+    size_t alignment;
+    bool huge_pages;
+
+    AlignedAllocator(size_t alignment = alignof(T), bool huge_pages = false)
+        : alignment(alignment < alignof(T) ? alignof(T) : alignment), huge_pages(huge_pages)
+    {
+        assert((alignment & (alignment - 1)) == 0 && "The alignment must be a power of two");
+    }
+
+    template <typename U>
+    AlignedAllocator(const AlignedAllocator<U>& other) : AlignedAllocator(other.alignment, other.huge_pages)
+    {
+    }
+
+    T* allocate(size_t n)
+    {
+        return static_cast<T*>(aligned_allocate(n * sizeof(T), alignment, huge_pages));
+    }
+
+    void deallocate(T* block, size_t n)
+    {
+        aligned_free(block, n * sizeof(T), alignment, huge_pages);
+    }
+
+    template <typename U>
+    bool operator==(const AlignedAllocator<U>& other) const { return alignment == other.alignment && huge_pages == other.huge_pages; }
+    template <typename U>
+    bool operator!=(const AlignedAllocator<U>& other) const { return !(*this == other); }
+};
+
+// The dense array of entities in a ComponentContainer
+typedef std::vector<Entity, AlignedAllocator<Entity>> EntityArray;
+
+// Storage options of the dense arrays of ComponentContainer<Component>, specialize it to change them, e.g.,
+//     template<> struct ComponentStorage<Position> { static const size_t alignment = 64; static const bool huge_pages = true; };
+// aligns the 'components' and 'entities' arrays of positions to the cache line size and backs large arrays with huge pages
+template <typename Component>
+struct ComponentStorage
+{
+    static const size_t alignment = alignof(Component);
+    static const bool huge_pages = false;
+};
+
+// Splits 'count' elements of 'element_size' bytes into chunks for 'parts' threads
+// The chunk size is rounded up such that every chunk of an array aligned to 'alignment' starts at a multiple of 'alignment' bytes,
+// hence, threads that write to neighboring chunks never share a cache line
+inline size_t aligned_chunk_size(size_t count, size_t parts, size_t element_size, size_t alignment = 64)
+{
+    // The smallest number of elements that spans a multiple of 'alignment' bytes
+    size_t a = alignment, b = element_size;
+    while (b != 0)
+    {
+        size_t t = a % b;
+        a = b;
+        b = t;
+    }
+    size_t granularity = alignment / a;
+    size_t chunk = (count + parts - 1) / (parts > 0 ? parts : 1);
+    return (chunk + granularity - 1) / granularity * granularity;
+}
+
+// The lookup from entity id to the position of its component in the dense arrays of a ComponentContainer
+// The ids are split into pages of page_size slots, which are allocated when first used and freed when empty. A lookup is
+// a single probe without hashing, and the slot of an entity without a component is 'empty', such that a stale handle,
+// e.g., of a removed component, is detected by the same probe that finds the position.
+class SparseIndex
+{
+public:
+    static const unsigned int page_bits = 10;
+    static const unsigned int page_size = 1u << page_bits; // one 4 KiB page of slots
+    static const unsigned int empty = ~0u;
+private:
+    struct Page
+    {
+        unsigned int slots[page_size];
+        unsigned int count = 0;
+    };
+    std::vector<std::unique_ptr<Page>> pages;
+    size_t count = 0;
+public:
+    SparseIndex() {}
+    SparseIndex(SparseIndex&&) = default;
+    SparseIndex& operator=(SparseIndex&&) = default;
+
+    // Containers are copyable, the copy has its own pages
+    SparseIndex(const SparseIndex& other) : count(other.count)
+    {
+        for (const std::unique_ptr<Page>& page : other.pages)
+            pages.emplace_back(page ? new Page(*page) : nullptr);
+    }
+
+    SparseIndex& operator=(const SparseIndex& other)
+    {
+        SparseIndex copy(other);
+        return *this = std::move(copy);
+    }
+
+    // The position of id, or 'empty'
+    unsigned int find(unsigned int id) const
+    {
+        size_t p = id >> page_bits;
+        return p < pages.size() && pages[p] ? pages[p]->slots[id & (page_size - 1)] : empty;
+    }
+
+    bool contains(unsigned int id) const
+    {
+        return find(id) != empty;
+    }
+
+    void set(unsigned int id, unsigned int position)
+    {
+        size_t p = id >> page_bits;
+        if (p >= pages.size())
+            pages.resize(p + 1);
+        if (!pages[p])
+        {
+            pages[p].reset(new Page());
+            std::fill(pages[p]->slots, pages[p]->slots + page_size, empty);
+        }
+        unsigned int& slot = pages[p]->slots[id & (page_size - 1)];
+        if (slot == empty)
+        {
+            pages[p]->count++;
+            count++;
+        }
+        slot = position;
+    }
+
+    void erase(unsigned int id)
+    {
+        size_t p = id >> page_bits;
+        if (p >= pages.size() || !pages[p])
+            return;
+        unsigned int& slot = pages[p]->slots[id & (page_size - 1)];
+        if (slot == empty)
+            return;
+        slot = empty;
+        count--;
+        if (--pages[p]->count == 0)
+            pages[p].reset(); // ids aren't re-used, the page of old entities is likely not needed again
+    }
+
+    void clear()
+    {
+        pages.clear();
+        count = 0;
+    }
+
+    size_t size() const
+    {
+        return count;
+    }
+
+    size_t page_count() const
+    {
+        size_t result = 0;
+        for (const std::unique_ptr<Page>& page : pages)
+            result += page ? 1 : 0;
+        return result;
+    }
+
+    size_t bytes() const
+    {
+        return pages.capacity() * sizeof(std::unique_ptr<Page>) + page_count() * sizeof(Page);
+    }
+
+    // Drops the page pointers behind the highest used page
+    void shrink_to_fit()
+    {
+        while (!pages.empty() && !pages.back())
+            pages.pop_back();
+        pages.shrink_to_fit();
+    }
+};
+
+// A container that stores components of type 'Component' and associated entities
+template <typename Component> // A component can be any class
+class ComponentContainer : public ContainerInterface
+{
+private:
+    // The lookup from Entity -> array index
+    SparseIndex index;
+    bool registered = false;
+
+    // Exchanges the components at positions a and b and their lookups
+    void swap_positions(size_t a, size_t b)
+    {
+        if (a == b)
+            return;
+        std::swap(components[a], components[b]);
+        std::swap(entities[a], entities[b]);
+        index.set(entities[a], (unsigned int)a);
+        index.set(entities[b], (unsigned int)b);
+        if (!observers.empty())
+            notify_swap((unsigned int)a, (unsigned int)b);
+    }
+
+    // The end of tier t, the last tier ends at enabled_count and the disabled components form tier tier_count()
+    size_t& tier_boundary(size_t t)
+    {
+        return t < tier_ends.size() ? tier_ends[t] : enabled_count;
+    }
+
+    // Moves the component at position to the first position of tier 'to' > 'from', one swap per tier boundary
+    size_t move_to_later_tier(size_t position, size_t from, size_t to)
+    {
+        for (size_t t = from; t < to; t++)
+        {
+            size_t& end = tier_boundary(t);
+            swap_positions(position, --end);
+            position = end;
+        }
+        return position;
+    }
+
+    // Moves the component at position to the last position of tier 'to' < 'from'
+    size_t move_to_earlier_tier(size_t position, size_t from, size_t to)
+    {
+        for (size_t t = from; t > to; t--)
+        {
+            size_t& begin = tier_boundary(t - 1);
+            swap_positions(position, begin);
+            position = begin++;
+        }
+        return position;
+    }
+
+    size_t tier_of_position(size_t position)
+    {
+        if (position >= enabled_count)
+            return tier_count();
+        return std::upper_bound(tier_ends.begin(), tier_ends.end(), position) - tier_ends.begin();
+    }
+public:
+    // Container of all components of type 'Component'
+    std::vector<Component, AlignedAllocator<Component>> components;
+
+    // The corresponding entities
+    EntityArray entities;
+
+    // The components at positions [0, enabled_count) are enabled, the disabled ones are packed behind them
+    // Iterating over components[0, enabled_count) skips the disabled entities without testing each of them
+    size_t enabled_count = 0;
+
+    // The enabled range can be split further into update tiers, see set_tiers(), tier t ends at tier_ends[t] and the last
+    // tier at enabled_count
+    std::vector<size_t> tier_ends;
+    // Every how many frames the components of each tier are updated, see View::due()
+    std::vector<unsigned int> tier_intervals;
+
+    // Constructor that registers the type
+    ComponentContainer()
+        : components(AlignedAllocator<Component>(ComponentStorage<Component>::alignment, ComponentStorage<Component>::huge_pages))
+        , entities(AlignedAllocator<Entity>(ComponentStorage<Component>::alignment, ComponentStorage<Component>::huge_pages))
+    {
+    }
+
+    // The chunk size to split the components for 'parts' threads without sharing cache lines at the chunk boundaries
+    size_t parallel_chunk_size(size_t parts)
+    {
+        return aligned_chunk_size(components.size(), parts, sizeof(Component), components.get_allocator().alignment);
+    }
+
+    // Inserting a component c associated to entity e
+    inline Component& insert(Entity e, Component c, bool check_for_duplicates = true)
+    {
+        // Usually, every entity should only have one instance of each component type
+        assert(!(check_for_duplicates && index.contains(e)) && "Entity already contained in ECS registry");
+
+        TINYECS_ZONE("ComponentContainer::insert");
+        TINYECS_COUNT(inserts);
+        index.set(e, (unsigned int)components.size());
+        components.push_back(std::move(c)); // the move enforces move instead of copy constructor
+        entities.push_back(e);
+        if (!observers.empty())
+            notify_insert(e, (unsigned int)components.size() - 1);
+        // New components are enabled in the last tier, move the first disabled one behind it
+        return components[move_to_earlier_tier(components.size() - 1, tier_count(), tier_count() - 1)];
+    };
+
+    // The emplace function takes the the provided arguments Args, creates a new object of type Component, and inserts it into the ECS system
+    template<typename... Args>
+    Component& emplace(Entity e, Args &&... args) {
+        return insert(e, Component(std::forward<Args>(args)...)); // the forward ensures that arguments are moved not copied
+    };
+    template<typename... Args>
+    Component& emplace_with_duplicates(Entity e, Args &&... args) {
+        return insert(e, Component(std::forward<Args>(args)...), false); // the forward ensures that arguments are moved not copied
+    };
+
+    // A wrapper to return the component of an entity
+    // Note, the check that e has a component is the same lookup, a stale handle aborts also in release builds
+    Component& get(Entity e) {
+        TINYECS_COUNT(gets);
+        unsigned int position = index.find(e);
+        TINYECS_CHECK(position != SparseIndex::empty, "Entity not contained in ECS registry");
+        return components[position];
+    }
+
+    // Returns a pointer to the component of e or nullptr if e has none
+    // Note, this is a single lookup, while has() followed by get() looks up e twice
+    Component* try_get(Entity e) {
+        TINYECS_COUNT(gets);
+        unsigned int position = index.find(e);
+        return position == SparseIndex::empty ? nullptr : &components[position];
+    }
+
+    // Changes the component of e with f(Component&) and notifies the observers, e.g., to update indices
+    // Note, changes through get() are not observed, use patch() for components that are indexed
+    template<typename F>
+    Component& patch(Entity e, F f) {
+        TINYECS_COUNT(gets);
+        unsigned int cID = index.find(e);
+        TINYECS_CHECK(cID != SparseIndex::empty, "Entity not contained in ECS registry");
+        f(components[cID]);
+        if (!observers.empty())
+            notify_patch(e, cID);
+        return components[cID];
+    }
+
+    // Notifies the observers that the component at position i changed, e.g., after it was written in a batch
+    void patched(unsigned int i) {
+        if (!observers.empty())
+            notify_patch(entities[i], i);
+    }
+
+    // Check if entity has a component of type 'Component'
+    bool has(Entity entity) {
+        TINYECS_COUNT(hases);
+        return index.contains(entity);
+    }
+
+    // Remove an component and pack the container to re-use the empty space
+    void remove(Entity e)
+    {
+        TINYECS_ZONE("ComponentContainer::remove");
+        unsigned int position = index.find(e);
+        if (position != SparseIndex::empty)
+        {
+            TINYECS_COUNT(removes);
+            // Get the current position
+            int cID = position;
+            if ((size_t)cID < enabled_count)
+            {
+                // Move e to the end of the enabled range first, such that the back is a disabled component
+                cID = (int)move_to_later_tier(cID, tier_of_position(cID), tier_count() - 1);
+                enabled_count--;
+                if (enabled_count < components.size() - 1)
+                {
+                    swap_positions(cID, enabled_count);
+                    cID = (int)enabled_count;
+                }
+            }
+            if (!observers.empty())
+                notify_remove(e, cID);
+
+            // Move the last element to position cID using the move operator
+            // Note, components[cID] = components.back() would trigger the copy instead of move operator
+            components[cID] = std::move(components.back());
+            entities[cID] = entities.back(); // the entity is only a single index, copy it.
+            index.set(entities.back(), cID);
+
+            // Erase the old component and free its memory
+            index.erase(e);
+            components.pop_back();
+            entities.pop_back();
+            // Note, one could mark the id for re-use
+        }
+    };
+
+    // Sets the entity and component at position, or appends them if position is size(), e.g., to restore a snapshot in place
+    // Note, the observers aren't notified, hence, this is only allowed while there are none, and enabled_count is left to the caller
+    void overwrite(size_t position, Entity e, const Component& c)
+    {
+        assert(observers.empty() && "overwrite() bypasses the observers");
+        assert(position <= components.size() && "Position out of range");
+        if (position == components.size())
+        {
+            components.push_back(c);
+            entities.push_back(e);
+        }
+        else if (entities[position] == e)
+        {
+            components[position] = c; // the lookup is unchanged
+            return;
+        }
+        else
+        {
+            // The old entity may already have been overwritten at another position
+            if (index.find(entities[position]) == position)
+                index.erase(entities[position]);
+            components[position] = c;
+            entities[position] = e;
+        }
+        index.set(e, (unsigned int)position);
+    }
+
+    // Adds the lookups of the components at positions [begin, size()), which were appended to 'components' and 'entities'
+    // directly, e.g., by several threads at once, and notifies the observers about their insertion
+    void index_appended(size_t begin)
+    {
+        for (size_t i = begin; i < components.size(); i++)
+        {
+            assert(!index.contains(entities[i]) && "Entity already contained in ECS registry");
+            index.set(entities[i], (unsigned int)i);
+            TINYECS_COUNT(inserts);
+        }
+        if (!observers.empty())
+            for (size_t i = begin; i < components.size(); i++)
+                notify_insert(entities[i], (unsigned int)i);
+        // The appended components are enabled in the last tier, move the disabled ones behind them
+        for (size_t i = begin; i < components.size(); i++)
+            move_to_earlier_tier(i, tier_count(), tier_count() - 1);
+    }
+
+    // Moves all components of the staging containers to the end of this one, e.g., the per-thread containers of parallel spawners
+    // The arrays and the lookup grow once for all of them, and the staging containers are empty afterwards.
+    void merge(const std::vector<ComponentContainer*>& staging)
+    {
+        TINYECS_ZONE("ComponentContainer::merge");
+        size_t begin = components.size(), count = begin;
+        for (ComponentContainer* source : staging)
+            count += source->components.size();
+        components.reserve(count);
+        entities.reserve(count);
+        for (ComponentContainer* source : staging)
+        {
+            // A memmove for trivially copyable components
+            components.insert(components.end(), std::make_move_iterator(source->components.begin()), std::make_move_iterator(source->components.end()));
+            entities.insert(entities.end(), source->entities.begin(), source->entities.end());
+        }
+        index_appended(begin);
+        for (ComponentContainer* source : staging)
+            source->clear();
+    }
+
+    // Removes all components from position size on, without notifying the observers, see overwrite()
+    void truncate(size_t size)
+    {
+        assert(observers.empty() && "truncate() bypasses the observers");
+        for (size_t position = size; position < components.size(); position++)
+            if (index.find(entities[position]) == position)
+                index.erase(entities[position]);
+        enabled_count = std::min(enabled_count, size);
+        for (size_t& end : tier_ends)
+            end = std::min(end, size);
+        if (size < components.size())
+        {
+            components.erase(components.begin() + size, components.end());
+            entities.erase(entities.begin() + size, entities.end());
+        }
+    }
+
+    // Remove all components of type 'Component'
+    void clear()
+    {
+        TINYECS_ZONE("ComponentContainer::clear");
+        if (!observers.empty())
+            notify_clear();
+        index.clear();
+        components.clear();
+        entities.clear();
+        enabled_count = 0;
+        tier_ends.assign(tier_ends.size(), 0);
+    }
+
+    // Hides the component of e from views and queries in O(1), by swapping it behind the enabled range, one swap per later tier
+    void disable(Entity e)
+    {
+        size_t position = index.find(e);
+        TINYECS_CHECK(position != SparseIndex::empty, "Entity not contained in ECS registry");
+        if (position < enabled_count)
+            move_to_later_tier(position, tier_of_position(position), tier_count());
+    }
+
+    // Makes the component of e visible again in O(1), by swapping it to the front of the disabled range, it joins the last tier
+    void enable(Entity e)
+    {
+        size_t position = index.find(e);
+        TINYECS_CHECK(position != SparseIndex::empty, "Entity not contained in ECS registry");
+        if (position >= enabled_count)
+            move_to_earlier_tier(position, tier_count(), tier_count() - 1);
+    }
+
+    bool is_enabled(Entity e)
+    {
+        return index.find(e) < enabled_count; // 'empty' is larger than every position
+    }
+
+    // Splits the enabled components into update tiers, e.g., { 1, 4, 16 } updates tier 0 every frame, tier 1 every fourth
+    // frame, and tier 2 every 16th frame, when iterated with View::due()
+    // The components of each tier are stored contiguously, all components start in the last tier, as do inserted ones.
+    void set_tiers(std::vector<unsigned int> intervals)
+    {
+        assert(!intervals.empty() && "At least one tier is required");
+        tier_intervals = std::move(intervals);
+        tier_ends.assign(tier_intervals.size() - 1, 0);
+    }
+
+    size_t tier_count()
+    {
+        return tier_ends.size() + 1;
+    }
+
+    // Moves the enabled component of e to 'tier', with one swap per tier between its current and its new tier
+    void set_tier(Entity e, size_t tier)
+    {
+        assert(tier < tier_count() && "Tier out of range");
+        size_t position = index.find(e);
+        TINYECS_CHECK(position != SparseIndex::empty, "Entity not contained in ECS registry");
+        size_t current = tier_of_position(position);
+        assert(current < tier_count() && "Only enabled components have a tier");
+        if (tier > current)
+            move_to_later_tier(position, current, tier);
+        else if (tier < current)
+            move_to_earlier_tier(position, current, tier);
+    }
+
+    // The tier of e, or tier_count() if it is disabled
+    size_t tier_of(Entity e)
+    {
+        size_t position = index.find(e);
+        TINYECS_CHECK(position != SparseIndex::empty, "Entity not contained in ECS registry");
+        return tier_of_position(position);
+    }
+
+    // The positions [tier_begin(t), tier_end(t)) hold the components of tier t
+    size_t tier_begin(size_t t)
+    {
+        return t == 0 ? 0 : tier_boundary(t - 1);
+    }
+
+    size_t tier_end(size_t t)
+    {
+        return tier_boundary(t);
+    }
+
+    // Returns a pointer to the component of e or nullptr if e has none or it is disabled
+    Component* try_get_enabled(Entity e) {
+        TINYECS_COUNT(gets);
+        unsigned int position = index.find(e);
+        return position < enabled_count ? &components[position] : nullptr;
+    }
+
+    // Report the number of components of type 'Component'
+    size_t size()
+    {
+        return components.size();
+    }
+
+    // Report the memory use and the operation counts
+    ContainerStats stats()
+    {
+        ContainerStats result = operation_counts.stats();
+        result.count = components.size();
+        result.bytes_used = components.size() * (sizeof(Component) + sizeof(Entity));
+        result.bytes_reserved = components.capacity() * sizeof(Component) + entities.capacity() * sizeof(Entity);
+        result.index_bytes = index.bytes();
+        result.index_buckets = index.page_count() * SparseIndex::page_size;
+        result.load_factor = result.index_buckets ? (float)index.size() / result.index_buckets : 0.f;
+        return result;
+    }
+
+    // Release the unused capacity of the arrays and index pages, e.g., after a mass despawn
+    void shrink_to_fit()
+    {
+        TINYECS_ZONE("ComponentContainer::shrink_to_fit");
+        components.shrink_to_fit();
+        entities.shrink_to_fit();
+        index.shrink_to_fit();
+    }
+};
+
+// A container for a component that exists exactly once, such as the current time or the input state
+// The component is stored in place, hence, get() is a direct access without any hashing
+// Note, singletons are not associated with any entity, has(Entity) is always false and remove(Entity) does nothing
+template <typename Component>
+class SingletonContainer : public ContainerInterface
+{
+private:
+    // Uninitialized storage that holds the component when present, this avoids requiring a default constructor
+    typename std::aligned_storage<sizeof(Component), alignof(Component)>::type storage;
+    bool present = false;
+public:
+    SingletonContainer()
+    {
+    }
+
+    ~SingletonContainer()
+    {
+        clear();
+    }
+
+    // The single instance can't be duplicated
+    SingletonContainer(const SingletonContainer&) = delete;
+    SingletonContainer& operator=(const SingletonContainer&) = delete;
+
+    // Setting the component, an existing one is replaced
+    inline Component& insert(Component c)
+    {
+        TINYECS_COUNT(inserts);
+        clear();
+        new (&storage) Component(std::move(c));
+        present = true;
+        return *reinterpret_cast<Component*>(&storage);
+    }
+
+    // Constructs the component in place from the provided arguments Args
+    template<typename... Args>
+    Component& emplace(Args &&... args) {
+        TINYECS_COUNT(inserts);
+        clear();
+        new (&storage) Component(std::forward<Args>(args)...);
+        present = true;
+        return *reinterpret_cast<Component*>(&storage);
+    };
+
+    // Direct access to the component
+    Component& get() {
+        TINYECS_CHECK(present, "Singleton component not contained in ECS registry");
+        TINYECS_COUNT(gets);
+        return *reinterpret_cast<Component*>(&storage);
+    }
+
+    // Check if the singleton was set
+    bool has() {
+        TINYECS_COUNT(hases);
+        return present;
+    }
+
+    bool has(Entity) {
+        return false;
+    }
+
+    void remove(Entity) {
+    }
+
+    // Destroy the component
+    void clear()
+    {
+        if (present)
+        {
+            reinterpret_cast<Component*>(&storage)->~Component();
+            present = false;
+        }
+    }
+
+    // Report the number of components, either 0 or 1
+    size_t size()
+    {
+        return present ? 1 : 0;
+    }
+
+    ContainerStats stats()
+    {
+        ContainerStats result = operation_counts.stats();
+        result.count = size();
+        result.bytes_used = present ? sizeof(Component) : 0;
+        result.bytes_reserved = sizeof(Component);
+        return result;
+    }
+};
+
+// A container for components that many entities share with identical values, such as meshes or material descriptors
+// Equal values are stored only once in 'values' and each entity stores a small index into it
+// The Component type must be equality comparable and hashable with 'Hash'
+template <typename Component, typename Hash = std::hash<Component>>
+class SharedComponentContainer : public ContainerInterface
+{
+private:
+    // The hash map from Entity -> array index in 'entities' and 'value_ids'
+    std::unordered_map<unsigned int, unsigned int> map_entity_componentID;
+    // The hash of each value -> its slot in 'values', a multimap since different values can have the same hash
+    std::unordered_multimap<size_t, unsigned int> map_hash_valueID;
+    // Slots in 'values' that are no longer referenced and can be re-used
+    std::vector<unsigned int> free_valueIDs;
+    // Scratch memory for each_group(), kept to avoid re-allocation
+    std::vector<unsigned int> group_offsets;
+    std::vector<Entity> group_entities;
+
+    // Returns the slot of a value equal to c, creates one if none exists yet
+    unsigned int intern(Component c)
+    {
+        size_t hash = Hash()(c);
+        auto range = map_hash_valueID.equal_range(hash);
+        for (auto it = range.first; it != range.second; ++it)
+            if (values[it->second] == c)
+            {
+                ref_counts[it->second]++;
+                return it->second;
+            }
+
+        unsigned int vID;
+        if (free_valueIDs.empty())
+        {
+            vID = (unsigned int)values.size();
+            values.push_back(std::move(c));
+            ref_counts.push_back(1);
+        }
+        else
+        {
+            vID = free_valueIDs.back();
+            free_valueIDs.pop_back();
+            values[vID] = std::move(c);
+            ref_counts[vID] = 1;
+        }
+        map_hash_valueID.emplace(hash, vID);
+        return vID;
+    }
+
+    // Drops one reference, the slot is marked for re-use when no entity refers to it any more
+    // Note, the old value stays in memory until the slot is re-used
+    void release(unsigned int vID)
+    {
+        if (--ref_counts[vID] > 0)
+            return;
+        auto range = map_hash_valueID.equal_range(Hash()(values[vID]));
+        for (auto it = range.first; it != range.second; ++it)
+            if (it->second == vID)
+            {
+                map_hash_valueID.erase(it);
+                break;
+            }
+        free_valueIDs.push_back(vID);
+    }
+public:
+    // The unique values, slots with ref_counts[i] == 0 are unused
+    std::vector<Component> values;
+    // The number of entities referring to each value
+    std::vector<unsigned int> ref_counts;
+
+    // The entities and the slot of the value each of them refers to
+    std::vector<Entity> entities;
+    std::vector<unsigned int> value_ids;
+
+    SharedComponentContainer()
+    {
+    }
+
+    // Associating the value c with entity e, the value is shared with all entities that have an equal one
+    inline const Component& insert(Entity e, Component c, bool check_for_duplicates = true)
+    {
+        // Usually, every entity should only have one instance of each component type
+        assert(!(check_for_duplicates && map_entity_componentID.count(e)) && "Entity already contained in ECS registry");
+
+        TINYECS_COUNT(inserts);
+        unsigned int vID = intern(std::move(c));
+        map_entity_componentID[e] = (unsigned int)entities.size();
+        entities.push_back(e);
+        value_ids.push_back(vID);
+        if (!observers.empty())
+            notify_insert(e, (unsigned int)entities.size() - 1);
+        return values[vID];
+    };
+
+    // The emplace function takes the the provided arguments Args, creates a new object of type Component, and inserts it
+    template<typename... Args>
+    const Component& emplace(Entity e, Args &&... args) {
+        return insert(e, Component(std::forward<Args>(args)...));
+    };
+
+    // Read access to the shared value, it can't be changed in place since other entities refer to it too
+    const Component& get(Entity e) {
+        return values[value_id(e)];
+    }
+
+    // The slot in 'values', entities with equal values have the same id
+    unsigned int value_id(Entity e) {
+        TINYECS_COUNT(gets);
+        auto it = map_entity_componentID.find(e);
+        TINYECS_CHECK(it != map_entity_componentID.end(), "Entity not contained in ECS registry");
+        return value_ids[it->second];
+    }
+
+    // Copy-on-write modification, f changes a copy of the value which is then shared again
+    // Other entities referring to the old value are not affected
+    template<typename F>
+    void modify(Entity e, F f) {
+        TINYECS_COUNT(gets);
+        auto it = map_entity_componentID.find(e);
+        TINYECS_CHECK(it != map_entity_componentID.end(), "Entity not contained in ECS registry");
+        unsigned int cID = it->second;
+        unsigned int old_vID = value_ids[cID];
+        Component c = values[old_vID];
+        f(c);
+        value_ids[cID] = intern(std::move(c)); // interned before the release to keep an unchanged value alive
+        release(old_vID);
+        if (!observers.empty())
+            notify_patch(e, cID);
+    }
+
+    // Replaces the value of entity e
+    void set(Entity e, Component c) {
+        modify(e, [&c](Component& value) { value = std::move(c); });
+    }
+
+    // Check if entity has a component of type 'Component'
+    bool has(Entity entity) {
+        TINYECS_COUNT(hases);
+        return map_entity_componentID.count(entity) > 0;
+    }
+
+    // Remove the association of e and pack the container, the value is kept while other entities refer to it
+    void remove(Entity e)
+    {
+        auto it = map_entity_componentID.find(e);
+        if (it != map_entity_componentID.end())
+        {
+            TINYECS_COUNT(removes);
+            int cID = it->second;
+            if (!observers.empty())
+                notify_remove(e, cID);
+            release(value_ids[cID]);
+
+            // Move the last element to position cID
+            entities[cID] = entities.back();
+            value_ids[cID] = value_ids.back();
+            map_entity_componentID[entities.back()] = cID;
+
+            map_entity_componentID.erase(e);
+            entities.pop_back();
+            value_ids.pop_back();
+        }
+    };
+
+    // Remove all components of type 'Component'
+    void clear()
+    {
+        if (!observers.empty())
+            notify_clear();
+        map_entity_componentID.clear();
+        map_hash_valueID.clear();
+        free_valueIDs.clear();
+        values.clear();
+        ref_counts.clear();
+        entities.clear();
+        value_ids.clear();
+    }
+
+    // Report the number of entities that have a component of type 'Component'
+    size_t size()
+    {
+        return entities.size();
+    }
+
+    // Report the memory use, the bytes include the distinct values and the per-entity slots
+    ContainerStats stats()
+    {
+        ContainerStats result = operation_counts.stats();
+        result.count = entities.size();
+        result.bytes_used = unique_size() * (sizeof(Component) + sizeof(unsigned int)) + entities.size() * (sizeof(Entity) + sizeof(unsigned int));
+        result.bytes_reserved = values.capacity() * sizeof(Component) + ref_counts.capacity() * sizeof(unsigned int)
+            + entities.capacity() * sizeof(Entity) + value_ids.capacity() * sizeof(unsigned int) + free_valueIDs.capacity() * sizeof(unsigned int);
+        result.index_bytes = unordered_map_bytes(map_entity_componentID) + unordered_map_bytes(map_hash_valueID);
+        result.index_buckets = map_entity_componentID.bucket_count() + map_hash_valueID.bucket_count();
+        result.load_factor = map_entity_componentID.load_factor();
+        return result;
+    }
+
+    void shrink_to_fit()
+    {
+        entities.shrink_to_fit();
+        value_ids.shrink_to_fit();
+        free_valueIDs.shrink_to_fit();
+        group_offsets = std::vector<unsigned int>();
+        group_entities = std::vector<Entity>();
+        map_entity_componentID.rehash(0);
+        map_hash_valueID.rehash(0);
+    }
+
+    // Report the number of distinct values
+    size_t unique_size()
+    {
+        return values.size() - free_valueIDs.size();
+    }
+
+    // Iterates over all distinct values together with the entities that share it, e.g., to batch draw calls
+    // f is called as f(const Component& value, const Entity* entities, size_t count)
+    template<typename F>
+    void each_group(F f)
+    {
+        // Counting sort of the entities by their value slot
+        group_offsets.assign(values.size() + 1, 0);
+        for (unsigned int vID : value_ids)
+            group_offsets[vID + 1]++;
+        for (size_t i = 1; i < group_offsets.size(); i++)
+            group_offsets[i] += group_offsets[i - 1];
+        group_entities.assign(entities.begin(), entities.end()); // not resize(), default constructed entities would take new ids
+        for (size_t i = 0; i < entities.size(); i++)
+            group_entities[group_offsets[value_ids[i]]++] = entities[i];
+
+        // After the sort, group_offsets[vID] points to the end of the group of vID
+        unsigned int begin = 0;
+        for (unsigned int vID = 0; vID < values.size(); vID++)
+        {
+            unsigned int end = group_offsets[vID];
+            if (end > begin)
+                f((const Component&)values[vID], group_entities.data() + begin, (size_t)(end - begin));
+            begin = end;
+        }
+    }
+};
+
+// A view iterates over all entities that have a component in each of the 'Required' containers
+// Entities that have a component in an excluded container are skipped, and 'Optional' components are passed as a
+// pointer that is nullptr if the entity has none. Views are created with view() and refined by chaining, e.g.,
+//     view(registry.names, registry.walks).exclude(registry.swims).each([](Entity e, Name& name, Walks& walks) {});
+//     view(registry.names).optional(registry.swims).each([](Entity e, Name& name, Swims* swims) {});
+// The smallest required container drives the iteration and all other terms are single lookups per entity
+// Disabled components don't match, the driving container only iterates its enabled range
+// With due(frame), the first required container drives the iteration over the part of each update tier that is due in
+// this frame, see ComponentContainer::set_tiers()
+// Note, don't insert or remove components of the required containers while iterating over them
+template <typename Required, typename Optional>
+class View;
+
+template <typename... Required, typename... Optional>
+class View<std::tuple<Required...>, std::tuple<Optional...>>
+{
+private:
+    std::tuple<ComponentContainer<Required>*...> required;
+    std::tuple<ComponentContainer<Optional>*...> optionals;
+    std::vector<ContainerInterface*> excluded;
+    bool tiered = false;
+    unsigned int frame = 0;
+
+    template <typename R, typename O>
+    friend class View;
+
+    // The component of the driving container is at a known index, all others are looked up
+    template <size_t I>
+    typename std::tuple_element<I, std::tuple<Required...>>::type* lookup(Entity e, size_t index, size_t driver)
+    {
+        auto* container = std::get<I>(required);
+        return I == driver ? &container->components[index] : container->try_get_enabled(e);
+    }
+
+    // Calls f with the components of e, returns false if e doesn't match
+    // 'driver' is the container that e was taken from at position 'index', or no container if driver >= sizeof...(Required)
+    template <typename F, size_t... I, size_t... J>
+    bool visit_impl(Entity e, size_t index, size_t driver, F& f, std::index_sequence<I...>, std::index_sequence<J...>)
+    {
+        for (ContainerInterface* container : excluded)
+            if (container->has(e))
+                return false;
+
+        // The lookups stop at the first missing component, the braced list guarantees the order of evaluation
+        std::tuple<Required*...> components;
+        bool match = true;
+        int sequence[] = { 0, (match = match && (std::get<I>(components) = lookup<I>(e, index, driver)) != nullptr, 0)... };
+        (void)sequence;
+        if (!match)
+            return false;
+
+        f(e, *std::get<I>(components)..., std::get<J>(optionals)->try_get_enabled(e)...);
+        return true;
+    }
+
+    template <typename F, size_t... I>
+    void each_impl(F& f, std::index_sequence<I...> required_sequence)
+    {
+        if (tiered)
+        {
+            // A tier updated every n-th frame is split into n slices, one slice per frame keeps the work even
+            auto* container = std::get<0>(required);
+            for (size_t t = 0; t < container->tier_count(); t++)
+            {
+                size_t begin = container->tier_begin(t), count = container->tier_end(t) - begin;
+                size_t n = t < container->tier_intervals.size() ? container->tier_intervals[t] : 1;
+                size_t slice = frame % n;
+                for (size_t i = begin + count * slice / n; i < begin + count * (slice + 1) / n; i++)
+                    visit_impl(container->entities[i], i, 0, f, required_sequence, std::index_sequence_for<Optional...>());
+            }
+            return;
+        }
+
+        // Iterate over the enabled components of the smallest required container
+        size_t sizes[] = { std::get<I>(required)->enabled_count... };
+        EntityArray* entity_lists[] = { &std::get<I>(required)->entities... };
+        size_t driver = std::min_element(sizes, sizes + sizeof...(Required)) - sizes;
+
+        EntityArray& entities = *entity_lists[driver];
+        for (size_t i = 0; i < sizes[driver]; i++)
+            visit_impl(entities[i], i, driver, f, required_sequence, std::index_sequence_for<Optional...>());
+    }
+
+public:
+    View(std::tuple<ComponentContainer<Required>*...> required, std::tuple<ComponentContainer<Optional>*...> optionals, std::vector<ContainerInterface*> excluded)
+        : required(required), optionals(optionals), excluded(std::move(excluded))
+    {
+    }
+
+    // Skip all entities that have a component in 'container'
+    View& exclude(ContainerInterface& container)
+    {
+        excluded.push_back(&container);
+        return *this;
+    }
+
+    // Pass the component of 'container' as an additional pointer argument, nullptr if an entity has none
+    template <typename Component>
+    View<std::tuple<Required...>, std::tuple<Optional..., Component>> optional(ComponentContainer<Component>& container)
+    {
+        View<std::tuple<Required...>, std::tuple<Optional..., Component>> result(
+            required, std::tuple_cat(optionals, std::make_tuple(&container)), excluded);
+        result.tiered = tiered;
+        result.frame = frame;
+        return result;
+    }
+
+    // Only visit the components of the first required container that are due in 'frame' by their update tier
+    // Note, every component is visited once in n frames for a tier interval of n, hence, scale the time step by n
+    View& due(unsigned int frame)
+    {
+        tiered = true;
+        this->frame = frame;
+        return *this;
+    }
+
+    // Calls f(Entity, Required&..., Optional*...) for all matching entities
+    template <typename F>
+    void each(F f)
+    {
+        each_impl(f, std::index_sequence_for<Required...>());
+    }
+
+    // Calls f(Entity, Required&..., Optional*...) if e matches the view, returns whether it did
+    template <typename F>
+    bool visit(Entity e, F f)
+    {
+        return visit_impl(e, 0, sizeof...(Required), f, std::index_sequence_for<Required...>(), std::index_sequence_for<Optional...>());
+    }
+};
+
+// Creates a view over all entities that have a component in each of the given containers
+template <typename... Required>
+View<std::tuple<Required...>, std::tuple<>> view(ComponentContainer<Required>&... containers)
+{
+    static_assert(sizeof...(Required) > 0, "A view requires at least one container");
+    return View<std::tuple<Required...>, std::tuple<>>(std::make_tuple(&containers...), std::tuple<>(), std::vector<ContainerInterface*>());
+}
+
+// The cost of keeping a Query up to date
+struct QueryStats
+{
+    size_t notifications = 0; // insert, remove, and clear notifications handled
+    size_t lookups = 0; // container lookups to test if an entity matches
+    size_t matches_added = 0;
+    size_t matches_removed = 0;
+    size_t rebuilds = 0; // full scans, after an excluded container was cleared
+};
+
+// A persistent query keeps the list of all entities that have a component in each of the 'Required' containers
+// In contrast to a View, the matches are updated incrementally when components are inserted or removed, hence,
+// iterating over them costs time proportional to the number of matches and not to the size of the containers
+// The position of each component is cached, such that each() accesses them without any lookup
+// Entities with a disabled component stay matched but each() skips them
+// Note, don't insert or remove components of the observed containers while iterating over a query
+template <typename... Required>
+class Query : public ContainerObserver
+{
+private:
+    static const size_t count = sizeof...(Required);
+
+    std::tuple<ComponentContainer<Required>*...> required;
+    std::array<ContainerInterface*, count> required_list;
+    std::array<EntityArray*, count> entity_lists;
+    std::vector<ContainerInterface*> excluded;
+
+    // Entity -> position in 'entities' and 'indices'
+    std::unordered_map<unsigned int, unsigned int> map_entity_matchID;
+    bool needs_rebuild = false;
+
+    template <size_t... I>
+    std::array<ContainerInterface*, count> make_required_list(std::index_sequence<I...>)
+    {
+        return std::array<ContainerInterface*, count>{ { std::get<I>(required)... } };
+    }
+
+    template <size_t... I>
+    std::array<EntityArray*, count> make_entity_lists(std::index_sequence<I...>)
+    {
+        return std::array<EntityArray*, count>{ { &std::get<I>(required)->entities... } };
+    }
+
+    // Looks up the component of e in the required container I, returns false if there is none
+    template <size_t I>
+    bool lookup(Entity e, unsigned int& index)
+    {
+        stats.lookups++;
+        auto* container = std::get<I>(required);
+        auto* component = container->try_get(e);
+        if (!component)
+            return false;
+        index = (unsigned int)(component - container->components.data());
+        return true;
+    }
+
+    // Adds e if it has all required components and none of the excluded ones, 'ignored' is an excluded container that is about to lose e
+    template <size_t... I>
+    void try_add(Entity e, ContainerInterface* ignored, std::index_sequence<I...>)
+    {
+        if (map_entity_matchID.count(e))
+            return;
+        for (ContainerInterface* container : excluded)
+            if (container != ignored && (stats.lookups++, container->has(e)))
+                return;
+
+        std::array<unsigned int, count> index;
+        bool match = true;
+        int sequence[] = { 0, (match = match && lookup<I>(e, index[I]), 0)... };
+        (void)sequence;
+        if (!match)
+            return;
+
+        map_entity_matchID[e] = (unsigned int)entities.size();
+        entities.push_back(e);
+        indices.push_back(index);
+        stats.matches_added++;
+    }
+
+    void erase(Entity e)
+    {
+        auto it = map_entity_matchID.find(e);
+        if (it == map_entity_matchID.end())
+            return;
+
+        // Move the last match to the position of e
+        unsigned int mID = it->second;
+        entities[mID] = entities.back();
+        indices[mID] = indices.back();
+        map_entity_matchID[entities.back()] = mID;
+        map_entity_matchID.erase(e);
+        entities.pop_back();
+        indices.pop_back();
+        stats.matches_removed++;
+    }
+
+    template <typename F, size_t... I>
+    void each_impl(F& f, std::index_sequence<I...>)
+    {
+        size_t enabled[] = { std::get<I>(required)->enabled_count... };
+        for (size_t i = 0; i < entities.size(); i++)
+        {
+            bool match = true;
+            int sequence[] = { 0, (match = match && indices[i][I] < enabled[I], 0)... };
+            (void)sequence;
+            if (match)
+                f(entities[i], std::get<I>(required)->components[indices[i][I]]...);
+        }
+    }
+
+public:
+    // The matching entities and the positions of their components in each required container
+    std::vector<Entity> entities;
+    std::vector<std::array<unsigned int, count>> indices;
+
+    QueryStats stats;
+
+    Query(ComponentContainer<Required>&... containers) : required(&containers...)
+    {
+        static_assert(sizeof...(Required) > 0, "A query requires at least one container");
+        required_list = make_required_list(std::index_sequence_for<Required...>());
+        entity_lists = make_entity_lists(std::index_sequence_for<Required...>());
+        for (ContainerInterface* container : required_list)
+            container->connect(this);
+        rebuild();
+    }
+
+    ~Query()
+    {
+        for (ContainerInterface* container : required_list)
+            container->disconnect(this);
+        for (ContainerInterface* container : excluded)
+            container->disconnect(this);
+    }
+
+    Query(const Query&) = delete;
+    Query& operator=(const Query&) = delete;
+
+    // Drop all entities that have a component in 'container'
+    Query& exclude(ContainerInterface& container)
+    {
+        excluded.push_back(&container);
+        container.connect(this);
+        rebuild();
+        return *this;
+    }
+
+    // Recomputes all matches by scanning the smallest required container
+    void rebuild()
+    {
+        map_entity_matchID.clear();
+        entities.clear();
+        indices.clear();
+        needs_rebuild = false;
+        stats.rebuilds++;
+
+        size_t driver = 0;
+        for (size_t i = 1; i < count; i++)
+            if (required_list[i]->size() < required_list[driver]->size())
+                driver = i;
+        for (Entity e : *entity_lists[driver])
+            try_add(e, nullptr, std::index_sequence_for<Required...>());
+    }
+
+    // Calls f(Entity, Required&...) for all matching entities
+    template <typename F>
+    void each(F f)
+    {
+        if (needs_rebuild)
+            rebuild();
+        each_impl(f, std::index_sequence_for<Required...>());
+    }
+
+    // Report the number of matching entities
+    size_t size()
+    {
+        if (needs_rebuild)
+            rebuild();
+        return entities.size();
+    }
+
+    void on_insert(ContainerInterface& container, Entity e, unsigned int)
+    {
+        stats.notifications++;
+        if (needs_rebuild)
+            return;
+        if (std::find(required_list.begin(), required_list.end(), &container) != required_list.end())
+            try_add(e, nullptr, std::index_sequence_for<Required...>());
+        else
+            erase(e); // inserted into an excluded container
+    }
+
+    void on_remove(ContainerInterface& container, Entity e, unsigned int index)
+    {
+        stats.notifications++;
+        if (needs_rebuild)
+            return;
+        auto k = std::find(required_list.begin(), required_list.end(), &container) - required_list.begin();
+        if (k == (long)count)
+        {
+            // Removed from an excluded container, e may match from now on
+            try_add(e, &container, std::index_sequence_for<Required...>());
+            return;
+        }
+
+        erase(e);
+
+        // The container moves its last component to the position of the removed one
+        Entity moved = entity_lists[k]->back();
+        auto it = map_entity_matchID.find(moved);
+        if (it != map_entity_matchID.end())
+            indices[it->second][k] = index;
+    }
+
+    void on_clear(ContainerInterface& container)
+    {
+        stats.notifications++;
+        if (std::find(required_list.begin(), required_list.end(), &container) != required_list.end())
+        {
+            map_entity_matchID.clear();
+            entities.clear();
+            indices.clear();
+        }
+        else
+            needs_rebuild = true; // the excluded container is still filled, rebuild once it is cleared
+    }
+
+    void on_swap(ContainerInterface& container, unsigned int a, unsigned int b)
+    {
+        stats.notifications++;
+        if (needs_rebuild)
+            return;
+        auto k = std::find(required_list.begin(), required_list.end(), &container) - required_list.begin();
+        if (k == (long)count)
+            return; // the excluded containers only matter by has()
+        unsigned int swapped[] = { a, b };
+        for (unsigned int index : swapped)
+        {
+            auto it = map_entity_matchID.find((*entity_lists[k])[index]);
+            if (it != map_entity_matchID.end())
+                indices[it->second][k] = index;
+        }
+    }
+};
+
+// A reactive collector gathers the entities that gained a 'Trigger' component while having all 'With' components
+// A system that reacts to rare changes, e.g., initializing a physics body when Walks is added to an entity with a Position,
+// visits just these entities instead of scanning the whole container every frame:
+//     Collector<Walks, Position> new_walkers(registry.walks, registry.positions);
+//     new_walkers.each([](Entity e, Walks& walks, Position& position) {}); // visits and forgets the collected entities
+// Each entity is collected once, and it is dropped again if it loses any of the components before the system runs.
+// Note, gaining a 'With' component after the 'Trigger' doesn't collect the entity
+template <typename Trigger, typename... With>
+class Collector : public ContainerObserver
+{
+private:
+    ComponentContainer<Trigger>* trigger;
+    std::tuple<ComponentContainer<With>*...> with;
+    std::array<ContainerInterface*, sizeof...(With)> with_list;
+
+    // Entity -> position in 'entities'
+    std::unordered_map<unsigned int, unsigned int> map_entity_collectedID;
+
+    void erase(Entity e)
+    {
+        auto it = map_entity_collectedID.find(e);
+        if (it == map_entity_collectedID.end())
+            return;
+
+        // Move the last entity to the position of e
+        unsigned int cID = it->second;
+        entities[cID] = entities.back();
+        map_entity_collectedID[entities.back()] = cID;
+        map_entity_collectedID.erase(e);
+        entities.pop_back();
+    }
+
+    template <typename F, size_t... I>
+    void each_impl(F& f, std::index_sequence<I...>)
+    {
+        // Visit a copy, f may change the containers and thereby the collected entities
+        std::vector<Entity> collected;
+        collected.swap(entities);
+        map_entity_collectedID.clear();
+        for (Entity e : collected)
+        {
+            // Earlier calls of f may have removed components of e
+            Trigger* component = trigger->try_get(e);
+            std::tuple<With*...> components(std::get<I>(with)->try_get(e)...);
+            bool match = component != nullptr;
+            int sequence[] = { 0, (match = match && std::get<I>(components) != nullptr, 0)... };
+            (void)sequence;
+            (void)components; // unused without 'With' components
+            if (match)
+                f(e, *component, *std::get<I>(components)...);
+        }
+    }
+public:
+    // The collected entities, in the order they gained the trigger component
+    // Note, removing a collected entity moves the last one to its position
+    std::vector<Entity> entities;
+
+    Collector(ComponentContainer<Trigger>& trigger, ComponentContainer<With>&... with)
+        : trigger(&trigger), with(&with...), with_list{ { &with... } }
+    {
+        trigger.connect(this);
+        for (ContainerInterface* container : with_list)
+            container->connect(this);
+    }
+
+    ~Collector()
+    {
+        trigger->disconnect(this);
+        for (ContainerInterface* container : with_list)
+            container->disconnect(this);
+    }
+
+    Collector(const Collector&) = delete;
+    Collector& operator=(const Collector&) = delete;
+
+    // Calls f(Entity, Trigger&, With&...) for all collected entities and forgets them
+    template <typename F>
+    void each(F f)
+    {
+        each_impl(f, std::index_sequence_for<With...>());
+    }
+
+    // Forgets the collected entities without visiting them
+    void clear()
+    {
+        map_entity_collectedID.clear();
+        entities.clear();
+    }
+
+    // Report the number of collected entities
+    size_t size()
+    {
+        return entities.size();
+    }
+
+    void on_insert(ContainerInterface& container, Entity e, unsigned int)
+    {
+        if (&container != trigger || map_entity_collectedID.count(e))
+            return;
+        for (ContainerInterface* required : with_list)
+            if (!required->has(e))
+                return;
+        map_entity_collectedID[e] = (unsigned int)entities.size();
+        entities.push_back(e);
+    }
+
+    void on_remove(ContainerInterface&, Entity e, unsigned int)
+    {
+        erase(e);
+    }
+
+    void on_clear(ContainerInterface&)
+    {
+        clear(); // all collected entities have a component in each observed container
+    }
+};
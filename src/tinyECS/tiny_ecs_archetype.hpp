@@ -0,0 +1,521 @@
+#pragma once
+
+#include "tiny_ecs.hpp"
+#include <memory>
+#include <map>
+#include <cstdint>
+
+// An alternative storage backend that groups entities by their set of components, called their archetype
+// All entities of an archetype are stored together in fixed-size chunks with one column per component type,
+// such that iterating over several components reads each column sequentially without any lookup.
+// Adding or removing a component moves the entity to another archetype, which copies its row.
+// In comparison to ComponentContainer, iterating over many components at once is faster, while adding and
+// removing components is slower. ArchetypeContainer provides the per-entity interface of ComponentContainer on top
+// of an ArchetypeWorld, such that a registry's inserts, gets, and removes can switch between the two by changing the
+// container types. It isn't a drop-in replacement, iteration goes through ArchetypeWorld::each() instead of views.
+
+// Type-erased operations on a component type, used to move rows between archetypes
+struct ArchetypeComponentInfo
+{
+    unsigned int id; // consecutive id of the component type, starting from 0
+    size_t size;
+    size_t align;
+    void (*move_construct)(void* destination, void* source);
+    void (*destroy)(void* component);
+};
+
+// Returns the next free component type id, shared by all ArchetypeWorlds
+inline unsigned int archetype_next_component_id()
+{
+    static unsigned int id_count = 0;
+    return id_count++;
+}
+
+template <typename Component>
+void archetype_move_construct(void* destination, void* source)
+{
+    new (destination) Component(std::move(*static_cast<Component*>(source)));
+}
+
+template <typename Component>
+void archetype_destroy(void* component)
+{
+    static_cast<Component*>(component)->~Component();
+}
+
+template <typename Component>
+const ArchetypeComponentInfo& archetype_component_info()
+{
+    static const ArchetypeComponentInfo info = { archetype_next_component_id(), sizeof(Component), alignof(Component),
+        &archetype_move_construct<Component>, &archetype_destroy<Component> };
+    return info;
+}
+
+// The storage of all entities that have exactly the same set of component types
+class Archetype
+{
+public:
+    // A fixed-size block of memory that holds 'chunk_capacity' rows, the columns are stored one after the other
+    struct Chunk
+    {
+        std::unique_ptr<unsigned char[]> memory;
+        unsigned char* data; // 'memory' aligned to the cache line size
+    };
+
+    static const size_t alignment = 64;
+
+    std::vector<const ArchetypeComponentInfo*> types; // sorted by id
+    std::vector<int> column_of_type; // component type id -> column, -1 if the type is not part of the archetype
+    std::vector<size_t> offsets; // byte offset of each column in a chunk, the entity ids are at offset 0
+    size_t chunk_size;
+    size_t chunk_capacity; // rows per chunk
+    std::vector<Chunk> chunks;
+    size_t size = 0; // number of rows, all chunks but the last one are full
+
+    // Cached transitions to the archetype with one more or one less component type
+    std::unordered_map<unsigned int, Archetype*> add_edges;
+    std::unordered_map<unsigned int, Archetype*> remove_edges;
+
+    Archetype(std::vector<const ArchetypeComponentInfo*> types_sorted, size_t chunk_size) : types(std::move(types_sorted)), chunk_size(chunk_size)
+    {
+        for (size_t c = 0; c < types.size(); c++)
+        {
+            if (types[c]->id >= column_of_type.size())
+                column_of_type.resize(types[c]->id + 1, -1);
+            column_of_type[types[c]->id] = (int)c;
+        }
+
+        // Find the largest number of rows whose columns fit into a chunk, at least one
+        size_t row_size = sizeof(unsigned int);
+        for (const ArchetypeComponentInfo* type : types)
+            row_size += type->size;
+        chunk_capacity = std::max<size_t>(1, chunk_size / row_size);
+        while (layout(chunk_capacity) > chunk_size && chunk_capacity > 1)
+            chunk_capacity--;
+        this->chunk_size = std::max(chunk_size, layout(chunk_capacity));
+    }
+
+    ~Archetype()
+    {
+        for (size_t row = 0; row < size; row++)
+            for (size_t c = 0; c < types.size(); c++)
+                types[c]->destroy(component(c, row));
+    }
+
+    Archetype(const Archetype&) = delete;
+    Archetype& operator=(const Archetype&) = delete;
+
+    // Computes the column offsets for 'rows' rows per chunk and returns the required chunk size
+    size_t layout(size_t rows)
+    {
+        offsets.resize(types.size());
+        size_t offset = rows * sizeof(unsigned int);
+        for (size_t c = 0; c < types.size(); c++)
+        {
+            size_t align = std::max(types[c]->align, alignof(unsigned int));
+            offset = (offset + align - 1) / align * align;
+            offsets[c] = offset;
+            offset += rows * types[c]->size;
+        }
+        return offset;
+    }
+
+    int column(unsigned int type_id)
+    {
+        return type_id < column_of_type.size() ? column_of_type[type_id] : -1;
+    }
+
+    unsigned int& entity(size_t row)
+    {
+        return reinterpret_cast<unsigned int*>(chunks[row / chunk_capacity].data)[row % chunk_capacity];
+    }
+
+    void* component(size_t column, size_t row)
+    {
+        return chunks[row / chunk_capacity].data + offsets[column] + (row % chunk_capacity) * types[column]->size;
+    }
+
+    // The begin of a column in a chunk
+    void* column_data(size_t column, size_t chunk)
+    {
+        return chunks[chunk].data + offsets[column];
+    }
+
+    // Number of rows in a chunk, chunk * chunk_capacity must be less than size
+    size_t chunk_rows(size_t chunk)
+    {
+        return std::min(chunk_capacity, size - chunk * chunk_capacity);
+    }
+
+    // Appends an uninitialized row and returns its index, the caller constructs all components
+    size_t push_row(unsigned int entity_id)
+    {
+        if (size == chunks.size() * chunk_capacity)
+        {
+            Chunk chunk;
+            chunk.memory.reset(new unsigned char[chunk_size + alignment]);
+            uintptr_t address = reinterpret_cast<uintptr_t>(chunk.memory.get());
+            chunk.data = chunk.memory.get() + ((alignment - address % alignment) % alignment);
+            chunks.push_back(std::move(chunk));
+        }
+        entity(size) = entity_id;
+        return size++;
+    }
+
+    // Removes the row by moving the last row into it, the components of the row must be moved out or destroyed already
+    // Returns the id of the entity that moved into 'row', or 0 if no entity moved
+    unsigned int pop_row(size_t row)
+    {
+        size_t last = size - 1;
+        unsigned int moved = 0;
+        if (row != last)
+        {
+            moved = entity(last);
+            entity(row) = moved;
+            for (size_t c = 0; c < types.size(); c++)
+            {
+                types[c]->move_construct(component(c, row), component(c, last));
+                types[c]->destroy(component(c, last));
+            }
+        }
+        size--;
+        // Keep one empty chunk to avoid re-allocation when a single entity moves back and forth
+        if (chunks.size() > 1 && size + 2 * chunk_capacity <= chunks.size() * chunk_capacity)
+            chunks.pop_back();
+        return moved;
+    }
+
+    // Check if the archetype has all of the given component types
+    bool contains(const unsigned int* type_ids, size_t count)
+    {
+        for (size_t i = 0; i < count; i++)
+            if (column(type_ids[i]) < 0)
+                return false;
+        return true;
+    }
+};
+
+// All entities and their components stored by archetype
+class ArchetypeWorld
+{
+private:
+    // Where the components of an entity are stored
+    struct Location
+    {
+        Archetype* archetype;
+        size_t row;
+    };
+
+    size_t chunk_size;
+    std::map<std::vector<unsigned int>, std::unique_ptr<Archetype>> archetypes_by_signature;
+    std::unordered_map<unsigned int, Location> map_entity_location; // the entity is cast to uint to be hashable.
+    std::vector<size_t> component_counts; // per component type id
+
+    Archetype* find_or_create(std::vector<const ArchetypeComponentInfo*> types)
+    {
+        std::sort(types.begin(), types.end(), [](const ArchetypeComponentInfo* a, const ArchetypeComponentInfo* b) { return a->id < b->id; });
+        std::vector<unsigned int> signature;
+        for (const ArchetypeComponentInfo* type : types)
+            signature.push_back(type->id);
+        std::unique_ptr<Archetype>& archetype = archetypes_by_signature[signature];
+        if (!archetype)
+        {
+            archetype.reset(new Archetype(std::move(types), chunk_size));
+            archetypes.push_back(archetype.get());
+        }
+        return archetype.get();
+    }
+
+    Archetype* with_type(Archetype* from, const ArchetypeComponentInfo& type)
+    {
+        Archetype*& to = from->add_edges[type.id];
+        if (!to)
+        {
+            std::vector<const ArchetypeComponentInfo*> types = from->types;
+            types.push_back(&type);
+            to = find_or_create(types);
+        }
+        return to;
+    }
+
+    Archetype* without_type(Archetype* from, const ArchetypeComponentInfo& type)
+    {
+        Archetype*& to = from->remove_edges[type.id];
+        if (!to)
+        {
+            std::vector<const ArchetypeComponentInfo*> types;
+            for (const ArchetypeComponentInfo* t : from->types)
+                if (t != &type)
+                    types.push_back(t);
+            to = find_or_create(types);
+        }
+        return to;
+    }
+
+    // Moves the row of e to archetype 'to', components that 'to' doesn't have are destroyed
+    // Returns the new row, in which the components that are new in 'to' are still uninitialized
+    size_t move_entity(Entity e, Location& location, Archetype* to)
+    {
+        Archetype* from = location.archetype;
+        size_t row = to ? to->push_row(e) : 0;
+        for (size_t c = 0; c < from->types.size(); c++)
+        {
+            void* source = from->component(c, location.row);
+            int destination = to ? to->column(from->types[c]->id) : -1;
+            if (destination >= 0)
+                from->types[c]->move_construct(to->component(destination, row), source);
+            from->types[c]->destroy(source);
+        }
+        fill_hole(from, location.row);
+        location.archetype = to;
+        location.row = row;
+        return row;
+    }
+
+    // Removes a row whose components were moved out and updates the location of the entity that filled its place
+    void fill_hole(Archetype* archetype, size_t row)
+    {
+        unsigned int moved = archetype->pop_row(row);
+        if (moved)
+            map_entity_location[moved].row = row;
+    }
+
+    void count(unsigned int type_id, int difference)
+    {
+        if (type_id >= component_counts.size())
+            component_counts.resize(type_id + 1, 0);
+        component_counts[type_id] += difference;
+    }
+
+    template <typename F, typename... Components, size_t... I>
+    void each_in_archetype(Archetype* archetype, F& f, std::index_sequence<I...>)
+    {
+        const unsigned int type_ids[] = { archetype_component_info<Components>().id... };
+        size_t columns[] = { (size_t)archetype->column(type_ids[I])... };
+        for (size_t chunk = 0; chunk * archetype->chunk_capacity < archetype->size; chunk++)
+        {
+            size_t rows = archetype->chunk_rows(chunk);
+            unsigned int* entity_ids = reinterpret_cast<unsigned int*>(archetype->chunks[chunk].data);
+            std::tuple<Components*...> column_data(static_cast<Components*>(archetype->column_data(columns[I], chunk))...);
+            for (size_t row = 0; row < rows; row++)
+                f(Entity::from_id(entity_ids[row]), std::get<I>(column_data)[row]...);
+        }
+    }
+
+public:
+    // All archetypes in order of creation
+    std::vector<Archetype*> archetypes;
+
+    // The chunk size in bytes, larger chunks hold more entities per archetype
+    ArchetypeWorld(size_t chunk_size = 16 * 1024) : chunk_size(chunk_size)
+    {
+    }
+
+    ArchetypeWorld(const ArchetypeWorld&) = delete;
+    ArchetypeWorld& operator=(const ArchetypeWorld&) = delete;
+
+    // Inserting a component c associated to entity e, moves e to the archetype that includes 'Component'
+    template <typename Component>
+    Component& insert(Entity e, Component c)
+    {
+        const ArchetypeComponentInfo& type = archetype_component_info<Component>();
+        auto it = map_entity_location.find(e);
+        Archetype* to;
+        size_t row;
+        if (it == map_entity_location.end())
+        {
+            to = find_or_create({ &type });
+            row = to->push_row(e);
+            map_entity_location[e] = Location{ to, row };
+        }
+        else
+        {
+            // Usually, every entity should only have one instance of each component type
+            assert(it->second.archetype->column(type.id) < 0 && "Entity already contained in ECS registry");
+            to = with_type(it->second.archetype, type);
+            row = move_entity(e, it->second, to);
+        }
+        count(type.id, 1);
+        Component* component = static_cast<Component*>(to->component(to->column(type.id), row));
+        new (component) Component(std::move(c));
+        return *component;
+    }
+
+    template <typename Component, typename... Args>
+    Component& emplace(Entity e, Args &&... args) {
+        return insert(e, Component(std::forward<Args>(args)...));
+    };
+
+    // Returns a pointer to the component of e or nullptr if e has none
+    template <typename Component>
+    Component* try_get(Entity e)
+    {
+        auto it = map_entity_location.find(e);
+        if (it == map_entity_location.end())
+            return nullptr;
+        int column = it->second.archetype->column(archetype_component_info<Component>().id);
+        return column < 0 ? nullptr : static_cast<Component*>(it->second.archetype->component(column, it->second.row));
+    }
+
+    template <typename Component>
+    Component& get(Entity e)
+    {
+        Component* component = try_get<Component>(e);
+        TINYECS_CHECK(component, "Entity not contained in ECS registry");
+        return *component;
+    }
+
+    template <typename Component>
+    bool has(Entity e)
+    {
+        return try_get<Component>(e) != nullptr;
+    }
+
+    // The row of e in its archetype, it changes whenever a component is added to or removed from e
+    size_t row(Entity e)
+    {
+        auto it = map_entity_location.find(e);
+        TINYECS_CHECK(it != map_entity_location.end(), "Entity not contained in ECS registry");
+        return it->second.row;
+    }
+
+    // Remove the component of e, moves e to the archetype without 'Component'
+    template <typename Component>
+    void remove(Entity e)
+    {
+        const ArchetypeComponentInfo& type = archetype_component_info<Component>();
+        auto it = map_entity_location.find(e);
+        if (it == map_entity_location.end() || it->second.archetype->column(type.id) < 0)
+            return;
+        count(type.id, -1);
+        if (it->second.archetype->types.size() == 1)
+        {
+            // The entity has no components left
+            move_entity(e, it->second, nullptr);
+            map_entity_location.erase(e);
+            return;
+        }
+        move_entity(e, it->second, without_type(it->second.archetype, type));
+    }
+
+    // Remove all components of type 'Component'
+    template <typename Component>
+    void clear()
+    {
+        const ArchetypeComponentInfo& type = archetype_component_info<Component>();
+        for (size_t a = 0; a < archetypes.size(); a++)
+            while (archetypes[a]->column(type.id) >= 0 && archetypes[a]->size > 0)
+                remove<Component>(Entity::from_id(archetypes[a]->entity(archetypes[a]->size - 1)));
+    }
+
+    // Remove all entities and components
+    // Note, the observers of the ArchetypeContainers aren't notified, clear the containers one by one to notify them
+    void clear()
+    {
+        archetypes.clear();
+        archetypes_by_signature.clear();
+        map_entity_location.clear();
+        component_counts.clear();
+    }
+
+    // Report the number of components of type 'Component'
+    template <typename Component>
+    size_t size()
+    {
+        unsigned int id = archetype_component_info<Component>().id;
+        return id < component_counts.size() ? component_counts[id] : 0;
+    }
+
+    // Report the number of entities with at least one component
+    size_t entity_count()
+    {
+        return map_entity_location.size();
+    }
+
+    // Calls f(Entity, Components&...) for all entities that have all of the components, chunk by chunk
+    // Note, don't insert or remove components while iterating
+    template <typename... Components, typename F>
+    void each(F f)
+    {
+        const unsigned int type_ids[] = { archetype_component_info<Components>().id... };
+        for (Archetype* archetype : archetypes)
+            if (archetype->size > 0 && archetype->contains(type_ids, sizeof...(Components)))
+                each_in_archetype<F, Components...>(archetype, f, std::index_sequence_for<Components...>());
+    }
+};
+
+// The insert(), get(), patch(), has(), and remove() interface of ComponentContainer<Component> for the components in an
+// ArchetypeWorld, it isn't a drop-in replacement:
+// - the 'components' and 'entities' arrays don't exist, so view() and Query can't use it, iterate with ArchetypeWorld::each()
+// - the components can't be disabled or put into update tiers
+// - observers are notified of inserts, removes, patches, and clears through this container, but their 'index' is the row
+//   of the entity in its archetype. Rows move without a notification, when the entity or another entity of the archetype
+//   gains or loses a component, hence observers that keep positions, such as SlicedCursor, don't work with it.
+template <typename Component>
+class ArchetypeContainer : public ContainerInterface
+{
+private:
+    ArchetypeWorld& world;
+public:
+    ArchetypeContainer(ArchetypeWorld& world) : world(world)
+    {
+    }
+
+    // An entity has at most one component per type in an archetype, with check_for_duplicates false inserting a component
+    // that e already has replaces it, like the duplicate that ComponentContainer::get() returns
+    inline Component& insert(Entity e, Component c, bool check_for_duplicates = true)
+    {
+        if (!check_for_duplicates && world.has<Component>(e))
+            return patch(e, [&c](Component& component) { component = std::move(c); });
+        Component& component = world.insert(e, std::move(c));
+        if (!observers.empty())
+            notify_insert(e, (unsigned int)world.row(e));
+        return component;
+    };
+
+    template<typename... Args>
+    Component& emplace(Entity e, Args &&... args) {
+        return insert(e, Component(std::forward<Args>(args)...));
+    };
+
+    Component& get(Entity e) {
+        return world.get<Component>(e);
+    }
+
+    Component* try_get(Entity e) {
+        return world.try_get<Component>(e);
+    }
+
+    // Changes the component of e with f(Component&) and notifies the observers
+    template<typename F>
+    Component& patch(Entity e, F f) {
+        Component& component = world.get<Component>(e);
+        f(component);
+        if (!observers.empty())
+            notify_patch(e, (unsigned int)world.row(e));
+        return component;
+    }
+
+    bool has(Entity entity) {
+        return world.has<Component>(entity);
+    }
+
+    void remove(Entity e)
+    {
+        if (!observers.empty() && world.has<Component>(e))
+            notify_remove(e, (unsigned int)world.row(e));
+        world.remove<Component>(e);
+    };
+
+    void clear()
+    {
+        if (!observers.empty())
+            notify_clear();
+        world.clear<Component>();
+    }
+
+    size_t size()
+    {
+        return world.size<Component>();
+    }
+};
@@ -0,0 +1,169 @@
+#pragma once
+
+#include "tiny_ecs.hpp"
+#include <atomic>
+#include <memory>
+#include <cstdint>
+
+// Inserting into a ComponentContainer from several threads at once, e.g., from parallel spawn systems
+// The inserter grows the container's arrays up front. Each insert() reserves a position with an atomic increment, writes
+// the component in place, and publishes the entity in a lock-free hash table, such that the new components can be found
+// while the threads are still inserting. finish() shrinks the arrays to the inserted components and adds them to the
+// container's lookup in one pass.
+//     ConcurrentInserter<Position> inserter(registry.positions, max_spawns);
+//     // in parallel: inserter.insert(Entity(), Position{ x, y });
+//     inserter.finish(); // after all threads joined
+// Note, the container must not be used otherwise until finish(), other than reading the components that existed before.
+// Its 'components' and 'entities' arrays and size() include all max_inserts reserved positions until finish().
+// Note, the reserved positions are default-constructed up front and insert() move-assigns into them, hence the component
+// must be default constructible and assignable.
+// Note, with a single thread plain insert() is faster, every insert() here costs two atomic operations on top of the
+// writes, and the constructor and finish() each make a pass over the reserved positions.
+// StagingContainers are the alternative without any shared state, every thread inserts into its own container.
+
+template <typename Component>
+class ConcurrentInserter
+{
+    static_assert(std::is_default_constructible<Component>::value, "The ConcurrentInserter default-constructs the reserved positions");
+
+    ComponentContainer<Component>& container;
+    size_t begin; // the first position of the inserted components
+    size_t capacity; // the maximal number of inserts
+    std::atomic<size_t> next;
+    bool finished = false;
+
+    // Open addressing table of the entity in the upper and the position in the lower 32 bits, 0 marks an empty slot
+    std::unique_ptr<std::atomic<uint64_t>[]> slots;
+    size_t table_mask;
+
+    // The table is indexed by the id like SparseIndex, such that the inserts of consecutive entities stay within a few pages
+    // Consecutive ids, e.g., of entities spawned by different threads at the same time, go to different cache lines
+    size_t home(uint32_t id) const
+    {
+        return ((id & ~63u) | (id & 7u) << 3 | (id >> 3 & 7u)) & table_mask;
+    }
+public:
+    // Makes room for max_inserts components, this is the only allocation until finish()
+    ConcurrentInserter(ComponentContainer<Component>& container, size_t max_inserts)
+        : container(container), begin(container.size()), capacity(max_inserts), next(0)
+    {
+        TINYECS_ZONE("ConcurrentInserter::ConcurrentInserter");
+        container.components.resize(begin + capacity);
+        container.entities.resize(begin + capacity, Entity::from_id(0));
+
+        size_t table_size = 16;
+        while (table_size < 2 * capacity)
+            table_size *= 2;
+        table_mask = table_size - 1;
+        slots.reset(new std::atomic<uint64_t>[table_size]);
+        for (size_t i = 0; i < table_size; i++)
+            slots[i].store(0, std::memory_order_relaxed);
+    }
+
+    ~ConcurrentInserter()
+    {
+        finish();
+    }
+
+    ConcurrentInserter(const ConcurrentInserter&) = delete;
+    ConcurrentInserter& operator=(const ConcurrentInserter&) = delete;
+
+    // Inserts c for entity e, can be called by several threads at once
+    Component& insert(Entity e, Component c)
+    {
+        size_t position = next.fetch_add(1, std::memory_order_relaxed);
+        TINYECS_CHECK(position < capacity, "More inserts than reserved by the ConcurrentInserter");
+        position += begin;
+        container.components[position] = std::move(c);
+        container.entities[position] = e;
+
+        // Publish the entity and its position at once, the release makes the component visible to try_get()
+        uint32_t id = e;
+        TINYECS_CHECK(id != 0, "Entity 0 is the default initialization and can't be inserted concurrently");
+        uint64_t slot = (uint64_t)id << 32 | (uint32_t)position;
+        for (size_t i = home(id); ; i = (i + 1) & table_mask)
+        {
+            uint64_t expected = 0;
+            if (slots[i].compare_exchange_strong(expected, slot, std::memory_order_release, std::memory_order_relaxed))
+                break;
+            TINYECS_CHECK((uint32_t)(expected >> 32) != id, "Entity already contained in ECS registry");
+        }
+        return container.components[position];
+    }
+
+    template<typename... Args>
+    Component& emplace(Entity e, Args &&... args) {
+        return insert(e, Component(std::forward<Args>(args)...));
+    };
+
+    // Returns the component that was inserted for e by this inserter, or nullptr, can be called while inserting
+    Component* try_get(Entity e)
+    {
+        uint32_t id = e;
+        for (size_t i = home(id); ; i = (i + 1) & table_mask)
+        {
+            uint64_t slot = slots[i].load(std::memory_order_acquire);
+            if (slot == 0)
+                return nullptr;
+            if ((uint32_t)(slot >> 32) == id)
+                return &container.components[(uint32_t)slot];
+        }
+    }
+
+    // Number of components inserted so far
+    size_t size() const
+    {
+        return std::min(next.load(std::memory_order_relaxed), capacity);
+    }
+
+    // Drops the unused positions and adds the inserted components to the container, after all inserting threads finished
+    void finish()
+    {
+        if (finished)
+            return;
+        finished = true;
+        TINYECS_ZONE("ConcurrentInserter::finish");
+        size_t end = begin + size();
+        container.components.erase(container.components.begin() + end, container.components.end());
+        container.entities.erase(container.entities.begin() + end, container.entities.end());
+        container.index_appended(begin);
+        slots.reset();
+    }
+};
+
+// One container per thread for the components created in a parallel phase, merged into the main container at the end
+// The threads never contend, while the merge copies every component once more than the ConcurrentInserter.
+//     StagingContainers<Position> staging(thread_count);
+//     // in thread t: staging[t].insert(Entity(), Position{ x, y });
+//     staging.merge_into(registry.positions); // after all threads joined
+template <typename Component>
+class StagingContainers
+{
+    std::vector<std::unique_ptr<ComponentContainer<Component>>> containers; // separate allocations, such that threads don't share cache lines
+public:
+    StagingContainers(size_t thread_count)
+    {
+        for (size_t t = 0; t < thread_count; t++)
+            containers.emplace_back(new ComponentContainer<Component>());
+    }
+
+    // The container of thread t, only to be used by that thread until merge_into()
+    ComponentContainer<Component>& operator[](size_t t)
+    {
+        return *containers[t];
+    }
+
+    size_t thread_count()
+    {
+        return containers.size();
+    }
+
+    // Moves the components of all threads to the end of destination, in the order of the threads, and keeps the staging capacity for the next phase
+    void merge_into(ComponentContainer<Component>& destination)
+    {
+        std::vector<ComponentContainer<Component>*> staging;
+        for (auto& container : containers)
+            staging.push_back(container.get());
+        destination.merge(staging);
+    }
+};
@@ -0,0 +1,567 @@
+#pragma once
+
+#include "tiny_ecs.hpp"
+#include <memory>
+#include <cstring>
+#include <cstdint>
+
+// Delta snapshots that only contain the components added, removed, or patched since a baseline tick
+// A DeltaRecorder observes a set of containers and encodes the changes compactly, e.g., to write a replay or crash
+// recovery log every tick instead of full snapshots. Another recorder over a matching set of containers applies them.
+//     DeltaRecorder recorder;
+//     recorder.track(registry.positions);
+//     recorder.track(registry.healths);
+//     std::vector<uint8_t> delta = recorder.encode(tick); // the changes since the previous encode(), tick is the new baseline
+//     replica.apply(delta); // replica tracks the containers of another registry in the same order
+// Containers of shared components and singletons are tracked too, e.g., recorder.track(registry.meshes); recorder.track(registry.time);
+// Note, changes made through get() or by writing to 'components' directly are not observed, use patch() instead
+// Note, singletons aren't observed, encode() compares them with their value at the baseline, also after changes through get()
+// Note, apply() checks the whole delta before changing any container and returns false for a corrupt or mismatching one
+
+/////////////////////////////////////////
+// Binary encoding
+
+// Appends v as a variable length integer, 7 bits per byte, small values take a single byte
+inline void delta_write_varint(std::vector<uint8_t>& out, uint64_t v)
+{
+    while (v >= 0x80)
+    {
+        out.push_back((uint8_t)(v | 0x80));
+        v >>= 7;
+    }
+    out.push_back((uint8_t)v);
+}
+
+// Appends sorted entity ids as the first id followed by the differences to the previous one
+inline void delta_write_entities(std::vector<uint8_t>& out, const std::vector<unsigned int>& sorted_ids)
+{
+    delta_write_varint(out, sorted_ids.size());
+    unsigned int previous = 0;
+    for (unsigned int id : sorted_ids)
+    {
+        delta_write_varint(out, id - previous);
+        previous = id;
+    }
+}
+
+// Reads what the delta_write functions wrote
+// A truncated or corrupt delta sets 'failed', after which all reads return zeros and empty lists
+struct DeltaReader
+{
+    const uint8_t* data;
+    const uint8_t* end;
+    bool failed = false;
+
+    DeltaReader(const uint8_t* data, const uint8_t* end) : data(data), end(end) {}
+
+    void fail()
+    {
+        failed = true;
+        data = end;
+    }
+
+    uint64_t varint()
+    {
+        uint64_t v = 0;
+        for (int shift = 0; ; shift += 7)
+        {
+            if (data == end || shift >= 64)
+            {
+                fail();
+                return 0;
+            }
+            uint8_t byte = *data++;
+            v |= (uint64_t)(byte & 0x7f) << shift;
+            if (!(byte & 0x80))
+                return v;
+        }
+    }
+
+    // A varint that must fit into an unsigned int
+    unsigned int uint()
+    {
+        uint64_t v = varint();
+        if (v > 0xFFFFFFFFu)
+            fail();
+        return failed ? 0 : (unsigned int)v;
+    }
+
+    void bytes(void* destination, size_t count)
+    {
+        if ((size_t)(end - data) < count)
+        {
+            fail();
+            memset(destination, 0, count);
+            return;
+        }
+        memcpy(destination, data, count);
+        data += count;
+    }
+
+    // The ids must be strictly ascending, every id takes at least one byte
+    std::vector<unsigned int> entities()
+    {
+        uint64_t count = varint();
+        if (count > (uint64_t)(end - data))
+            fail();
+        std::vector<unsigned int> ids(failed ? 0 : (size_t)count);
+        uint64_t previous = 0;
+        for (size_t i = 0; i < ids.size(); i++)
+        {
+            uint64_t difference = varint();
+            uint64_t id = previous + difference;
+            if (failed || (i > 0 && difference == 0) || difference > 0xFFFFFFFFu || id > 0xFFFFFFFFu)
+            {
+                fail();
+                return std::vector<unsigned int>();
+            }
+            previous = ids[i] = (unsigned int)id;
+        }
+        return ids;
+    }
+};
+
+// How a component is written to and read from a delta, components that aren't trivially copyable need a specialization, e.g.,
+// template<> struct ComponentSerializer<Inventory> { static void write(std::vector<uint8_t>& out, const Inventory& c); static void read(DeltaReader& in, Inventory& c); };
+template <typename Component>
+struct ComponentSerializer
+{
+    static_assert(std::is_trivially_copyable<Component>::value, "Specialize ComponentSerializer for components that aren't trivially copyable");
+
+    static void write(std::vector<uint8_t>& out, const Component& c)
+    {
+        const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&c);
+        out.insert(out.end(), bytes, bytes + sizeof(Component));
+    }
+
+    static void read(DeltaReader& in, Component& c)
+    {
+        in.bytes(&c, sizeof(Component));
+    }
+};
+
+/////////////////////////////////////////
+// Changes of one container
+
+struct DeltaSectionInterface
+{
+    virtual ~DeltaSectionInterface() {}
+    virtual bool changed() = 0;
+    virtual bool has(Entity e) = 0;
+    virtual void removed_entities(std::vector<unsigned int>& ids) = 0;
+    virtual void encode(std::vector<uint8_t>& out) = 0;
+    virtual bool validate(DeltaReader& in) = 0; // reads a section without applying it, false if apply() would fail
+    virtual void apply(DeltaReader& in) = 0;
+    virtual void rebase() = 0;
+};
+
+// The changes of a ComponentContainer or a SharedComponentContainer, per entity
+template <typename Component, typename Container = ComponentContainer<Component>>
+class DeltaSection : public DeltaSectionInterface, public ContainerObserver
+{
+    // The change of an entity's component relative to the baseline
+    enum class Change
+    {
+        Added,
+        Removed,
+        Patched
+    };
+
+    Container& container;
+    std::unordered_map<unsigned int, Change> map_entity_change; // the entity is cast to uint to be hashable.
+
+    // The sorted entities with the given change
+    std::vector<unsigned int> entities_with(Change change)
+    {
+        std::vector<unsigned int> ids;
+        for (const auto& entry : map_entity_change)
+            if (entry.second == change)
+                ids.push_back(entry.first);
+        std::sort(ids.begin(), ids.end());
+        return ids;
+    }
+
+    void write_components(std::vector<uint8_t>& out, const std::vector<unsigned int>& ids)
+    {
+        for (unsigned int id : ids)
+            ComponentSerializer<Component>::write(out, container.get(Entity::from_id(id)));
+    }
+
+    // Reads the new value of a patched component, through patch() or set() such that the observers are notified
+    static void read_patch(ComponentContainer<Component>& container, Entity e, DeltaReader& in)
+    {
+        container.patch(e, [&in](Component& c) { ComponentSerializer<Component>::read(in, c); });
+    }
+
+    template <typename Hash>
+    static void read_patch(SharedComponentContainer<Component, Hash>& container, Entity e, DeltaReader& in)
+    {
+        Component c;
+        ComponentSerializer<Component>::read(in, c);
+        container.set(e, std::move(c));
+    }
+public:
+    DeltaSection(Container& container) : container(container)
+    {
+        container.connect(this);
+    }
+
+    ~DeltaSection()
+    {
+        container.disconnect(this);
+    }
+
+    void on_insert(ContainerInterface&, Entity e, unsigned int) override
+    {
+        auto it = map_entity_change.find(e);
+        if (it == map_entity_change.end())
+            map_entity_change[e] = Change::Added;
+        else // removed and inserted again, the component existed at the baseline
+            it->second = Change::Patched;
+    }
+
+    void on_remove(ContainerInterface&, Entity e, unsigned int) override
+    {
+        auto it = map_entity_change.find(e);
+        if (it == map_entity_change.end())
+            map_entity_change[e] = Change::Removed;
+        else if (it->second == Change::Added) // didn't exist at the baseline
+            map_entity_change.erase(it);
+        else
+            it->second = Change::Removed;
+    }
+
+    void on_patch(ContainerInterface&, Entity e, unsigned int) override
+    {
+        auto it = map_entity_change.find(e);
+        if (it == map_entity_change.end())
+            map_entity_change[e] = Change::Patched;
+    }
+
+    void on_clear(ContainerInterface& c) override
+    {
+        for (size_t i = 0; i < container.entities.size(); i++)
+            on_remove(c, container.entities[i], (unsigned int)i);
+    }
+
+    bool changed() override
+    {
+        return !map_entity_change.empty();
+    }
+
+    bool has(Entity e) override
+    {
+        return container.has(e);
+    }
+
+    void removed_entities(std::vector<unsigned int>& ids) override
+    {
+        for (const auto& entry : map_entity_change)
+            if (entry.second == Change::Removed)
+                ids.push_back(entry.first);
+    }
+
+    // Removed entities, added entities and their components, patched entities and their components
+    void encode(std::vector<uint8_t>& out) override
+    {
+        delta_write_varint(out, sizeof(Component));
+        delta_write_entities(out, entities_with(Change::Removed));
+        std::vector<unsigned int> added = entities_with(Change::Added);
+        delta_write_entities(out, added);
+        write_components(out, added);
+        std::vector<unsigned int> patched = entities_with(Change::Patched);
+        delta_write_entities(out, patched);
+        write_components(out, patched);
+    }
+
+    // The components must fit to the container's state, added entities don't have a component and patched ones do
+    bool validate(DeltaReader& in) override
+    {
+        if (in.varint() != sizeof(Component))
+            return false;
+        std::vector<unsigned int> removed = in.entities();
+        auto contained = [&](unsigned int id) { return container.has(Entity::from_id(id)) && !std::binary_search(removed.begin(), removed.end(), id); };
+        std::vector<unsigned int> added = in.entities();
+        for (unsigned int id : added)
+        {
+            if (contained(id))
+                return false;
+            Component c;
+            ComponentSerializer<Component>::read(in, c);
+        }
+        for (unsigned int id : in.entities())
+        {
+            if (!contained(id) && !std::binary_search(added.begin(), added.end(), id))
+                return false;
+            Component c;
+            ComponentSerializer<Component>::read(in, c);
+        }
+        return !in.failed;
+    }
+
+    void apply(DeltaReader& in) override
+    {
+        size_t component_size = (size_t)in.varint();
+        assert(component_size == sizeof(Component) && "Delta section of another component type, call validate() first");
+        (void)component_size;
+        for (unsigned int id : in.entities())
+            container.remove(Entity::from_id(id));
+        for (unsigned int id : in.entities())
+        {
+            Component c;
+            ComponentSerializer<Component>::read(in, c);
+            container.insert(Entity::from_id(id), std::move(c));
+        }
+        for (unsigned int id : in.entities())
+            read_patch(container, Entity::from_id(id), in);
+    }
+
+    void rebase() override
+    {
+        map_entity_change.clear();
+    }
+};
+
+// The change of a singleton, found by comparing its encoding with the one at the baseline
+template <typename Component>
+class SingletonDeltaSection : public DeltaSectionInterface
+{
+    SingletonContainer<Component>& container;
+    std::vector<uint8_t> baseline; // the encoding at the baseline
+    std::vector<uint8_t> current; // scratch memory for the encoding of the current state
+
+    // Whether the singleton is present, followed by its value
+    void write_state(std::vector<uint8_t>& out)
+    {
+        out.clear();
+        delta_write_varint(out, container.has());
+        if (container.has())
+            ComponentSerializer<Component>::write(out, container.get());
+    }
+public:
+    SingletonDeltaSection(SingletonContainer<Component>& container) : container(container)
+    {
+        write_state(baseline);
+    }
+
+    bool changed() override
+    {
+        write_state(current);
+        return current != baseline;
+    }
+
+    bool has(Entity) override
+    {
+        return false;
+    }
+
+    void removed_entities(std::vector<unsigned int>&) override
+    {
+    }
+
+    void encode(std::vector<uint8_t>& out) override
+    {
+        delta_write_varint(out, sizeof(Component));
+        write_state(current);
+        out.insert(out.end(), current.begin(), current.end());
+    }
+
+    bool validate(DeltaReader& in) override
+    {
+        if (in.varint() != sizeof(Component))
+            return false;
+        uint64_t present = in.varint();
+        if (present > 1)
+            return false;
+        if (present)
+        {
+            Component c;
+            ComponentSerializer<Component>::read(in, c);
+        }
+        return !in.failed;
+    }
+
+    void apply(DeltaReader& in) override
+    {
+        in.varint();
+        if (in.varint())
+        {
+            Component c;
+            ComponentSerializer<Component>::read(in, c);
+            container.insert(std::move(c));
+        }
+        else
+            container.clear();
+    }
+
+    void rebase() override
+    {
+        write_state(baseline);
+    }
+};
+
+/////////////////////////////////////////
+// Changes of a set of containers
+
+// Delta layout, all integers are varints:
+//     "TECD", baseline tick, tick, begin and end of the created entity ids, destroyed entities,
+//     number of sections, per section: container position in the recorder and its changes
+
+// The ticks and the entity events of a delta
+struct DeltaInfo
+{
+    unsigned int baseline_tick;
+    unsigned int tick;
+    unsigned int created_begin; // entities with ids in [created_begin, created_end) were created
+    unsigned int created_end;
+    std::vector<unsigned int> destroyed; // entities that lost their last tracked component
+    bool valid = false; // false if the header is truncated or corrupt, the other fields are zero then
+
+    static DeltaInfo read(DeltaReader& in)
+    {
+        DeltaInfo info = {};
+        if (in.end - in.data < 4 || memcmp(in.data, "TECD", 4) != 0)
+        {
+            in.fail();
+            return info;
+        }
+        in.data += 4;
+        info.baseline_tick = in.uint();
+        info.tick = in.uint();
+        info.created_begin = in.uint();
+        info.created_end = in.uint();
+        info.destroyed = in.entities();
+        if (in.failed || info.created_begin > info.created_end)
+        {
+            in.fail();
+            return DeltaInfo();
+        }
+        info.valid = true;
+        return info;
+    }
+};
+
+// Reads the header of a delta, e.g., to log the created and destroyed entities
+inline DeltaInfo delta_info(const std::vector<uint8_t>& delta)
+{
+    DeltaReader in(delta.data(), delta.data() + delta.size());
+    return DeltaInfo::read(in);
+}
+class DeltaRecorder
+{
+    std::vector<std::unique_ptr<DeltaSectionInterface>> sections;
+    unsigned int baseline_entity_id = Entity::next_id();
+public:
+    unsigned int baseline_tick = 0;
+
+    // Records the changes of container, all recorders that exchange deltas must track their containers in the same order
+    template <typename Component>
+    void track(ComponentContainer<Component>& container)
+    {
+        sections.emplace_back(new DeltaSection<Component>(container));
+    }
+
+    template <typename Component, typename Hash>
+    void track(SharedComponentContainer<Component, Hash>& container)
+    {
+        sections.emplace_back(new DeltaSection<Component, SharedComponentContainer<Component, Hash>>(container));
+    }
+
+    template <typename Component>
+    void track(SingletonContainer<Component>& container)
+    {
+        sections.emplace_back(new SingletonDeltaSection<Component>(container));
+    }
+
+    // Encodes the changes since baseline_tick and makes tick the new baseline
+    std::vector<uint8_t> encode(unsigned int tick)
+    {
+        std::vector<uint8_t> out = { 'T', 'E', 'C', 'D' };
+        delta_write_varint(out, baseline_tick);
+        delta_write_varint(out, tick);
+        delta_write_varint(out, baseline_entity_id);
+        delta_write_varint(out, Entity::next_id());
+
+        // Entities that lost their last tracked component
+        std::vector<unsigned int> destroyed;
+        for (auto& section : sections)
+            section->removed_entities(destroyed);
+        std::sort(destroyed.begin(), destroyed.end());
+        destroyed.erase(std::unique(destroyed.begin(), destroyed.end()), destroyed.end());
+        destroyed.erase(std::remove_if(destroyed.begin(), destroyed.end(), [this](unsigned int id) {
+            for (auto& section : sections)
+                if (section->has(Entity::from_id(id)))
+                    return true;
+            return false;
+        }), destroyed.end());
+        delta_write_entities(out, destroyed);
+
+        size_t changed = 0;
+        for (auto& section : sections)
+            changed += section->changed();
+        delta_write_varint(out, changed);
+        for (size_t i = 0; i < sections.size(); i++)
+        {
+            if (!sections[i]->changed())
+                continue;
+            delta_write_varint(out, i);
+            sections[i]->encode(out);
+        }
+
+        rebase(tick);
+        return out;
+    }
+
+    // Checks that delta is complete, starts at this recorder's baseline_tick, and fits to the tracked containers
+    bool validate(const std::vector<uint8_t>& delta)
+    {
+        TINYECS_ZONE("DeltaRecorder::validate");
+        DeltaReader in(delta.data(), delta.data() + delta.size());
+        DeltaInfo info = DeltaInfo::read(in);
+        if (!info.valid || info.baseline_tick != baseline_tick)
+            return false;
+        uint64_t changed = in.varint();
+        if (changed > sections.size())
+            return false;
+        uint64_t previous = 0;
+        for (uint64_t i = 0; i < changed; i++)
+        {
+            // The sections are in the order of the tracked containers, each at most once
+            uint64_t section = in.varint();
+            if (in.failed || section >= sections.size() || (i > 0 && section <= previous))
+                return false;
+            if (!sections[section]->validate(in))
+                return false;
+            previous = section;
+        }
+        return !in.failed && in.data == in.end;
+    }
+
+    // Applies a delta encoded by another recorder, whose baseline must be this recorder's baseline_tick
+    // The containers are changed with insert(), remove(), and patch(), such that their observers are notified
+    // Returns false without changing anything if the delta is truncated, corrupt, or doesn't fit, see validate()
+    bool apply(const std::vector<uint8_t>& delta)
+    {
+        if (!validate(delta))
+            return false;
+        DeltaReader in(delta.data(), delta.data() + delta.size());
+        DeltaInfo info = DeltaInfo::read(in);
+        Entity::reserve_ids(info.created_end); // the destroyed entities lose their components in the sections
+
+        size_t changed = (size_t)in.varint();
+        for (size_t i = 0; i < changed; i++)
+            sections[(size_t)in.varint()]->apply(in);
+
+        rebase(info.tick);
+        return true;
+    }
+
+    // Drops the recorded changes, e.g., after writing a full snapshot at tick
+    void rebase(unsigned int tick)
+    {
+        for (auto& section : sections)
+            section->rebase();
+        baseline_tick = tick;
+        baseline_entity_id = Entity::next_id();
+    }
+};
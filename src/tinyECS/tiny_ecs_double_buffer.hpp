@@ -0,0 +1,171 @@
+#pragma once
+
+#include "tiny_ecs.hpp"
+
+// Double buffering of the components of a container, such that systems that read the current frame and systems that
+// write the next frame can run at the same time without locks
+// The container's components are the front buffer, which holds frame N and is only read during the frame, e.g., by views.
+// Writers change the back buffer through write(), which starts each frame as a copy of the front buffer. swap() at the
+// end of the frame exchanges both buffers in O(1) and copies the written components back, such that both agree again.
+// swap() visits only the blocks of 64 positions that were written and notifies the container's observers of each
+// written component as a patch, e.g., indices over the component.
+//     DoubleBuffer<Position> positions(registry.positions);
+//     // in parallel: read(i) for collisions, rendering, ...; write(i) for movement
+//     positions.swap(); // after all systems of the frame
+// Note, insert(), remove(), patch(), clear(), disable(), and enable() on the container are not allowed while systems read or write,
+// they are mirrored to the back buffer between frames.
+
+template <typename Component>
+class DoubleBuffer : public ContainerObserver
+{
+    typedef decltype(ComponentContainer<Component>::components) ComponentArray;
+    static const size_t block_size = 64;
+
+    ComponentContainer<Component>& container;
+    ComponentArray back; // frame N + 1, positions are the same as in container.components
+    std::vector<uint8_t> written; // one byte per position, such that threads writing different components don't share flags
+    std::unique_ptr<std::atomic<uint8_t>[]> block_written; // one flag per block of positions, shared by the writers of a block
+    size_t block_capacity = 0;
+    std::vector<unsigned int> written_blocks; // the first written_count entries are the blocks written in this frame
+    std::atomic<size_t> written_count{ 0 };
+    bool rescan = false; // positions moved after they were written, swap() checks all flags instead of the blocks
+
+    // Grows the block flags between frames, such that write() never reallocates
+    void reserve_blocks(size_t positions)
+    {
+        size_t blocks = (positions + block_size - 1) / block_size;
+        if (blocks > written_blocks.size())
+            written_blocks.resize(blocks);
+        if (blocks <= block_capacity)
+            return;
+        size_t capacity = std::max(blocks, 2 * block_capacity);
+        std::unique_ptr<std::atomic<uint8_t>[]> grown(new std::atomic<uint8_t>[capacity]);
+        for (size_t b = 0; b < capacity; b++)
+            grown[b].store(b < block_capacity ? block_written[b].load(std::memory_order_relaxed) : 0, std::memory_order_relaxed);
+        block_written = std::move(grown);
+        block_capacity = capacity;
+    }
+
+    void copy_back(size_t i)
+    {
+        written[i] = 0;
+        if (container.observers.size() == 1)
+            back[i] = container.components[i]; // this is the only observer
+        else
+            container.patched((unsigned int)i); // on_patch() copies the component to the back buffer
+    }
+public:
+    DoubleBuffer(ComponentContainer<Component>& container) : container(container), back(container.components), written(container.components.size(), 0)
+    {
+        reserve_blocks(back.size());
+        container.connect(this);
+    }
+
+    ~DoubleBuffer()
+    {
+        container.disconnect(this);
+    }
+
+    DoubleBuffer(const DoubleBuffer&) = delete;
+    DoubleBuffer& operator=(const DoubleBuffer&) = delete;
+
+    // The component at position i in frame N, the entity is container.entities[i]
+    const Component& read(size_t i) const
+    {
+        return container.components[i];
+    }
+
+    // The component at position i in frame N + 1, initially equal to read(i)
+    Component& write(size_t i)
+    {
+        if (!written[i])
+        {
+            written[i] = 1;
+            // The first writer of a block appends it to the list of written blocks
+            std::atomic<uint8_t>& block = block_written[i / block_size];
+            if (!block.load(std::memory_order_relaxed) && !block.exchange(1, std::memory_order_relaxed))
+                written_blocks[written_count.fetch_add(1, std::memory_order_relaxed)] = (unsigned int)(i / block_size);
+        }
+        return back[i];
+    }
+
+    // The component of e in frame N + 1
+    // Note, the lookup counts an operation of the container, which may miss counts when several threads write
+    Component& write(Entity e)
+    {
+        return write((size_t)(&container.get(e) - container.components.data()));
+    }
+
+    // Makes frame N + 1 the current frame, call it once all systems of the frame finished
+    void swap()
+    {
+        TINYECS_ZONE("DoubleBuffer::swap");
+        container.components.swap(back);
+        if (rescan)
+        {
+            for (size_t i = 0; i < written.size(); i++)
+                if (written[i])
+                    copy_back(i);
+            for (size_t b = 0; b < block_capacity; b++)
+                block_written[b].store(0, std::memory_order_relaxed);
+        }
+        else
+        {
+            size_t count = written_count.load(std::memory_order_relaxed);
+            for (size_t w = 0; w < count; w++)
+            {
+                size_t b = written_blocks[w];
+                block_written[b].store(0, std::memory_order_relaxed);
+                for (size_t i = b * block_size, end = std::min(i + block_size, written.size()); i < end; i++)
+                    if (written[i])
+                        copy_back(i);
+            }
+        }
+        written_count.store(0, std::memory_order_relaxed);
+        rescan = false;
+    }
+
+    size_t size()
+    {
+        return back.size();
+    }
+
+    // Mirrors the structural changes between frames, the back buffer keeps the positions of the front buffer
+    void on_insert(ContainerInterface&, Entity, unsigned int index) override
+    {
+        back.push_back(container.components[index]);
+        written.push_back(0);
+        reserve_blocks(back.size());
+    }
+
+    void on_remove(ContainerInterface&, Entity, unsigned int index) override
+    {
+        back[index] = std::move(back.back());
+        back.pop_back();
+        written[index] = written.back();
+        written.pop_back();
+        rescan |= written_count.load(std::memory_order_relaxed) > 0;
+    }
+
+    void on_patch(ContainerInterface&, Entity, unsigned int index) override
+    {
+        back[index] = container.components[index];
+    }
+
+    void on_clear(ContainerInterface&) override
+    {
+        back.clear();
+        written.clear();
+        for (size_t b = 0; b < block_capacity; b++)
+            block_written[b].store(0, std::memory_order_relaxed);
+        written_count.store(0, std::memory_order_relaxed);
+        rescan = false;
+    }
+
+    void on_swap(ContainerInterface&, unsigned int a, unsigned int b) override
+    {
+        std::swap(back[a], back[b]);
+        std::swap(written[a], written[b]);
+        rescan |= written_count.load(std::memory_order_relaxed) > 0;
+    }
+};
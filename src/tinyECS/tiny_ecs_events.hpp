@@ -0,0 +1,287 @@
+#pragma once
+
+#include "tiny_ecs.hpp"
+#include <atomic>
+#include <memory>
+#include <mutex>
+
+// Event streams store components that only live for one frame, e.g., damage or collision events
+// Events are appended by any number of threads, read by each consuming system through its own cursor, and dropped all at
+// once by reset() in O(1). The memory is kept for the next frame and nothing is hashed.
+//     EventStream<Damage> damages;
+//     damages.push(target, Damage{ 10 }); // from any thread
+//     EventWriter<Damage> writer(damages); // one per producing thread or system, for many events
+//     writer.push(target, Damage{ 10 });
+//     EventCursor cursor; // one per consuming system
+//     damages.read(cursor, [&](Entity target, const Damage& damage) {
+//         view(registry.healths).visit(target, [&](Entity, Health& health) { health.hit_points -= damage.amount; });
+//     });
+//     damages.reset(); // at the end of the frame
+// Note, readers only see the events pushed before they started, e.g., by threads that were joined, and reset() must not
+// overlap with push() or read(). The same holds for has(), e.g., when a view excludes the entities with an event.
+// Note, an EventStream is not a ComponentContainer and can't be a required container of a View or Query, joins go
+// through View::visit() as above and views can exclude() it.
+
+// The position of a consuming system in an EventStream, the stream knows when a cursor is from an earlier frame
+struct EventCursor
+{
+    size_t position = 0;
+    unsigned int frame = 0;
+};
+
+template <typename Event>
+class EventWriter;
+
+template <typename Event>
+class EventStream : public ContainerInterface
+{
+    friend class EventWriter<Event>;
+
+    static_assert(std::is_trivially_destructible<Event>::value, "Events are dropped without destruction by reset()");
+
+    struct Slot
+    {
+        Entity entity;
+        Event event;
+    };
+
+    // Events are stored in blocks that never move, such that pushing never invalidates the events of other threads
+    static const size_t block_size = 1024;
+    struct Block
+    {
+        typename std::aligned_storage<sizeof(Slot), alignof(Slot)>::type slots[block_size];
+    };
+
+    std::unique_ptr<std::atomic<Block*>[]> blocks;
+    size_t max_blocks;
+    std::atomic<size_t> next; // slots used this frame, including the empty slots of EventWriter batches
+    std::atomic<size_t> dropped{ 0 }; // empty slots of flushed batches
+    unsigned int frame = 1;
+
+    // The entities with an event, built by the first has() of a frame and extended by later ones if events were pushed
+    SparseIndex lookup;
+    std::atomic<unsigned int> lookup_frame{ 0 };
+    std::atomic<size_t> lookup_end{ 0 }; // the events in the lookup
+    std::mutex lookup_mutex; // concurrent has() calls build the lookup once
+
+    Block* block(size_t b)
+    {
+        Block* result = blocks[b].load(std::memory_order_acquire);
+        if (result)
+            return result;
+        // The first thread that needs the block allocates it, the others use the winner's block
+        Block* allocated = new Block();
+        if (blocks[b].compare_exchange_strong(result, allocated, std::memory_order_acq_rel))
+            return allocated;
+        delete allocated;
+        return result;
+    }
+
+    Event& write(size_t i, Entity e, Event& event)
+    {
+        TINYECS_CHECK(i < max_blocks * block_size, "More events than the EventStream holds per frame");
+        Slot* slot = new (&block(i / block_size)->slots[i % block_size]) Slot{ e, event };
+        return slot->event;
+    }
+
+    // The number of slots of this frame, empty or not
+    size_t slot_count()
+    {
+        return std::min(next.load(std::memory_order_acquire), max_blocks * block_size);
+    }
+
+    // Calls f(Slot&) for the events in the slots [begin, end), block by block, skipping empty slots
+    template <typename F>
+    void visit_slots(size_t begin, size_t end, F& f)
+    {
+        for (size_t i = begin; i < end; )
+        {
+            Slot* slots = reinterpret_cast<Slot*>(blocks[i / block_size].load(std::memory_order_relaxed)->slots);
+            size_t block_end = std::min(end, (i / block_size + 1) * block_size);
+            for (; i < block_end; i++)
+                if (slots[i % block_size].entity != 0)
+                    f(slots[i % block_size]);
+        }
+    }
+
+    // Claims count slots for an EventWriter and marks them empty, returns the first
+    size_t claim(size_t count)
+    {
+        size_t first = next.fetch_add(count, std::memory_order_relaxed);
+        size_t end = std::min(first + count, max_blocks * block_size);
+        for (size_t i = first; i < end; i++)
+            new (&block(i / block_size)->slots[i % block_size]) Entity(Entity::from_id(0)); // the entity is the first member of Slot
+        return first;
+    }
+
+    // Counts the claimed slots [begin, end) that an EventWriter left empty
+    void drop(size_t begin, size_t end)
+    {
+        end = std::min(end, max_blocks * block_size);
+        if (begin < end)
+            dropped.fetch_add(end - begin, std::memory_order_relaxed);
+    }
+
+    void index_events(size_t end)
+    {
+        TINYECS_ZONE("EventStream::index_events");
+        std::lock_guard<std::mutex> lock(lookup_mutex);
+        if (lookup_frame.load(std::memory_order_relaxed) != frame)
+        {
+            lookup.clear();
+            lookup_end.store(0, std::memory_order_relaxed);
+        }
+        auto index = [this](Slot& s) { lookup.set(s.entity, 0); };
+        visit_slots(lookup_end.load(std::memory_order_relaxed), end, index);
+        lookup_end.store(end, std::memory_order_release);
+        lookup_frame.store(frame, std::memory_order_release);
+    }
+public:
+    // Holds up to max_events per frame, the blocks are allocated when first needed
+    EventStream(size_t max_events = 1 << 22) : max_blocks((max_events + block_size - 1) / block_size), next(0)
+    {
+        blocks.reset(new std::atomic<Block*>[max_blocks]);
+        for (size_t b = 0; b < max_blocks; b++)
+            blocks[b].store(nullptr, std::memory_order_relaxed);
+    }
+
+    ~EventStream()
+    {
+        for (size_t b = 0; b < max_blocks; b++)
+            delete blocks[b].load(std::memory_order_relaxed);
+    }
+
+    EventStream(const EventStream&) = delete;
+    EventStream& operator=(const EventStream&) = delete;
+
+    // Appends an event for entity e, can be called by several threads at once
+    // Every push() is an atomic increment, an EventWriter amortizes it over a batch of events
+    Event& push(Entity e, Event event)
+    {
+        return write(next.fetch_add(1, std::memory_order_relaxed), e, event);
+    }
+
+    template<typename... Args>
+    Event& emplace(Entity e, Args &&... args) {
+        return push(e, Event(std::forward<Args>(args)...));
+    };
+
+    // Calls f(Entity, const Event&) for the events pushed since the cursor's last read in this frame and advances it
+    template <typename F>
+    void read(EventCursor& cursor, F f)
+    {
+        if (cursor.frame != frame)
+            cursor = EventCursor{ 0, frame };
+        size_t end = slot_count();
+        auto visit = [&f](Slot& s) { f(s.entity, (const Event&)s.event); };
+        visit_slots(cursor.position, end, visit);
+        cursor.position = end;
+    }
+
+    // Calls f(Entity, Event&) for all events of this frame
+    template <typename F>
+    void each(F f)
+    {
+        auto visit = [&f](Slot& s) { f(s.entity, s.event); };
+        visit_slots(0, slot_count(), visit);
+    }
+
+    // Drops all events in O(1), keeping the blocks for the next frame, the cursors restart at the first event of the next frame
+    void reset()
+    {
+        next.store(0, std::memory_order_relaxed);
+        dropped.store(0, std::memory_order_relaxed);
+        frame++;
+    }
+
+    // Drops all events, an EventStream in the registry list is reset with the other containers
+    void clear()
+    {
+        if (!observers.empty())
+            notify_clear();
+        reset();
+    }
+
+    // Number of events of this frame, it includes the unused slots of the batches of EventWriters until they are flushed
+    size_t size()
+    {
+        return slot_count() - dropped.load(std::memory_order_relaxed);
+    }
+
+    // Events are only dropped all at once, remove() does nothing
+    void remove(Entity) {}
+
+    // Checks if e has an event in this frame, the first call of a frame indexes the events, the others are a single probe
+    bool has(Entity e)
+    {
+        TINYECS_COUNT(hases);
+        size_t end = slot_count();
+        if (lookup_frame.load(std::memory_order_acquire) != frame || lookup_end.load(std::memory_order_acquire) < end)
+            index_events(end);
+        return lookup.contains(e);
+    }
+
+    ContainerStats stats()
+    {
+        ContainerStats result = operation_counts.stats();
+        result.count = size();
+        result.bytes_used = result.count * sizeof(Slot);
+        for (size_t b = 0; b < max_blocks; b++)
+            result.bytes_reserved += blocks[b].load(std::memory_order_relaxed) ? sizeof(Block) : 0;
+        result.index_bytes = max_blocks * sizeof(std::atomic<Block*>) + lookup.bytes();
+        return result;
+    }
+};
+
+// Appends the events of one producer, e.g., a thread or a system, to an EventStream
+// The writer claims batches of slots with a single atomic increment and fills them without further synchronization.
+// The slots of a batch are marked empty when claimed, such that readers skip those that stay unused.
+// Note, like push(), the events are seen by readers that start after the writer pushed them, and reset() must not overlap
+// with push(). A writer can be kept over several frames, it claims a new batch after a reset().
+template <typename Event>
+class EventWriter
+{
+    EventStream<Event>& stream;
+    size_t position = 0; // the slots [position, end) are claimed but not written yet
+    size_t end = 0;
+    unsigned int frame = 0;
+public:
+    static const size_t batch_size = 64;
+
+    EventWriter(EventStream<Event>& stream) : stream(stream)
+    {
+    }
+
+    ~EventWriter()
+    {
+        flush();
+    }
+
+    EventWriter(const EventWriter&) = delete;
+    EventWriter& operator=(const EventWriter&) = delete;
+
+    // Appends an event for entity e, only one thread may use a writer at a time
+    Event& push(Entity e, Event event)
+    {
+        if (position == end || frame != stream.frame)
+        {
+            frame = stream.frame;
+            position = stream.claim(batch_size);
+            end = position + batch_size;
+        }
+        return stream.write(position++, e, event);
+    }
+
+    template<typename... Args>
+    Event& emplace(Entity e, Args &&... args) {
+        return push(e, Event(std::forward<Args>(args)...));
+    };
+
+    // Releases the rest of the batch, such that the stream's size() counts only events, called by the destructor
+    void flush()
+    {
+        if (frame == stream.frame)
+            stream.drop(position, end);
+        position = end = 0;
+    }
+};
@@ -0,0 +1,259 @@
+#pragma once
+
+#include "tiny_ecs.hpp"
+#include <memory>
+#include <unordered_set>
+
+// A bounded history of the state of containers, e.g., to rewind the world by a few ticks and resimulate for rollback netcode
+// capture() records the state at the end of every tick. The containers are split into chunks and a capture only copies the
+// chunks that changed since the previous one, all other chunks are shared. rewind(ticks) restores the state of an earlier
+// capture, only writing back the chunks that differ from the current state, and keeps the order of the components, such
+// that a resimulation iterates them in the same order.
+//     History history(8);
+//     history.track(registry.positions);
+//     ... simulate tick ...
+//     history.capture();
+//     history.rewind(3); // the state of three captures before the latest one
+// Note, changes made through get() or by writing to 'components' directly are not observed, use patch() instead
+
+struct HistoryPoolInterface
+{
+    virtual ~HistoryPoolInterface() {}
+    virtual void capture(size_t slot) = 0;
+    virtual void restore(size_t slot, size_t latest_slot) = 0;
+    virtual size_t bytes() = 0;
+};
+
+template <typename Component>
+class HistoryPool : public HistoryPoolInterface, public ContainerObserver
+{
+    // A copy of the components at positions [chunk * chunk_capacity, chunk * chunk_capacity + size)
+    struct Chunk
+    {
+        std::vector<Entity> entities;
+        std::vector<Component> components;
+    };
+
+    // The state of the container at one capture
+    struct Snapshot
+    {
+        size_t count = 0;
+        size_t enabled_count = 0;
+        std::vector<size_t> tier_ends;
+        std::vector<std::shared_ptr<const Chunk>> chunks;
+    };
+
+    ComponentContainer<Component>& container;
+    std::vector<Snapshot> snapshots; // one per slot of the History ring buffer
+    std::vector<bool> dirty_chunks; // changed since the latest capture
+    bool all_dirty = true;
+    size_t latest = 0;
+
+    void mark_dirty(size_t position)
+    {
+        size_t chunk = position / chunk_capacity;
+        if (chunk >= dirty_chunks.size())
+            dirty_chunks.resize(chunk + 1, false);
+        dirty_chunks[chunk] = true;
+    }
+
+    bool dirty(size_t chunk) const
+    {
+        return all_dirty || chunk >= dirty_chunks.size() || dirty_chunks[chunk];
+    }
+
+    void clean()
+    {
+        dirty_chunks.assign(dirty_chunks.size(), false);
+        all_dirty = false;
+    }
+public:
+    // Entities per chunk, small enough to copy few components per change and large enough to share most of them
+    static const size_t chunk_capacity = 1024;
+
+    HistoryPool(ComponentContainer<Component>& container, size_t capacity) : container(container), snapshots(capacity)
+    {
+        container.connect(this);
+    }
+
+    ~HistoryPool()
+    {
+        container.disconnect(this);
+    }
+
+    // Inserts append at the back, removes move the back to the removed position
+    void on_insert(ContainerInterface&, Entity, unsigned int index) override
+    {
+        mark_dirty(index);
+    }
+
+    void on_remove(ContainerInterface&, Entity, unsigned int index) override
+    {
+        mark_dirty(index);
+        mark_dirty(container.size() - 1);
+    }
+
+    void on_patch(ContainerInterface&, Entity, unsigned int index) override
+    {
+        mark_dirty(index);
+    }
+
+    void on_clear(ContainerInterface&) override
+    {
+        all_dirty = true;
+    }
+
+    void on_swap(ContainerInterface&, unsigned int a, unsigned int b) override
+    {
+        mark_dirty(a);
+        mark_dirty(b);
+    }
+
+    // Shares the unchanged chunks of the latest capture and copies the others
+    void capture(size_t slot) override
+    {
+        const Snapshot& previous = snapshots[latest];
+        Snapshot& snapshot = snapshots[slot];
+        snapshot.count = container.size();
+        snapshot.enabled_count = container.enabled_count;
+        snapshot.tier_ends = container.tier_ends;
+        snapshot.chunks.resize((snapshot.count + chunk_capacity - 1) / chunk_capacity);
+        for (size_t c = 0; c < snapshot.chunks.size(); c++)
+        {
+            if (!dirty(c) && c < previous.chunks.size())
+            {
+                snapshot.chunks[c] = previous.chunks[c];
+                continue;
+            }
+            size_t begin = c * chunk_capacity, end = std::min(begin + chunk_capacity, snapshot.count);
+            std::shared_ptr<Chunk> chunk = std::make_shared<Chunk>();
+            chunk->entities.assign(container.entities.begin() + begin, container.entities.begin() + end);
+            chunk->components.assign(container.components.begin() + begin, container.components.begin() + end);
+            snapshot.chunks[c] = chunk;
+        }
+        latest = slot;
+        clean();
+    }
+
+    // Writes back the chunks that differ from the current state, i.e., changed since the latest capture or between both captures
+    void restore(size_t slot, size_t latest_slot) override
+    {
+        const Snapshot& target = snapshots[slot];
+        const Snapshot& current = snapshots[latest_slot];
+        bool fast = container.observers.size() == 1; // only this pool observes the container
+        if (fast)
+        {
+            container.disconnect(this);
+            container.truncate(std::min(container.size(), target.count));
+            for (size_t c = 0; c < target.chunks.size(); c++)
+            {
+                if (!dirty(c) && c < current.chunks.size() && target.chunks[c] == current.chunks[c])
+                    continue;
+                const Chunk& chunk = *target.chunks[c];
+                for (size_t i = 0; i < chunk.entities.size(); i++)
+                    container.overwrite(c * chunk_capacity + i, chunk.entities[i], chunk.components[i]);
+            }
+            container.truncate(target.count);
+            // The components are at their captured positions and no observer is connected that could track the partition
+            container.enabled_count = target.enabled_count;
+            container.tier_ends = target.tier_ends;
+            container.connect(this);
+        }
+        else
+        {
+            // Re-inserting all components in order notifies the other observers, e.g., indices and queries
+            container.disconnect(this);
+            container.clear();
+            for (const std::shared_ptr<const Chunk>& chunk : target.chunks)
+                for (size_t i = 0; i < chunk->entities.size(); i++)
+                    container.insert(chunk->entities[i], chunk->components[i]);
+            // The components are at their captured positions and enabled in the last tier, set_tier() and disable() restore
+            // the partition for the observers, in an order in which every component stays at its position
+            TINYECS_CHECK(container.tier_ends.size() == target.tier_ends.size(), "The tiers changed since the capture");
+            size_t last_tier = container.tier_count() - 1;
+            for (size_t t = 0; t < last_tier; t++)
+                for (size_t i = t > 0 ? target.tier_ends[t - 1] : 0; i < target.tier_ends[t]; i++)
+                    container.set_tier(container.entities[i], t);
+            for (size_t i = target.count; i > target.enabled_count; i--)
+                container.disable(container.entities[i - 1]);
+            container.connect(this);
+        }
+        latest = slot;
+        clean();
+    }
+
+    // The memory held by all captures, chunks shared by several captures are counted once
+    size_t bytes() override
+    {
+        std::unordered_set<const Chunk*> counted;
+        size_t result = 0;
+        for (const Snapshot& snapshot : snapshots)
+        {
+            result += snapshot.chunks.capacity() * sizeof(std::shared_ptr<const Chunk>);
+            for (const std::shared_ptr<const Chunk>& chunk : snapshot.chunks)
+                if (counted.insert(chunk.get()).second)
+                    result += chunk->entities.capacity() * sizeof(Entity) + chunk->components.capacity() * sizeof(Component);
+        }
+        return result;
+    }
+};
+
+// The captures of a set of containers in a ring buffer of a fixed number of ticks
+class History
+{
+    std::vector<std::unique_ptr<HistoryPoolInterface>> pools;
+    size_t capacity;
+    size_t latest = 0; // slot of the latest capture
+    size_t count = 0; // number of captures in the ring buffer
+public:
+    // Keeps the latest 'capacity' captures
+    History(size_t capacity) : capacity(capacity)
+    {
+        TINYECS_CHECK(capacity > 0, "History needs at least one capture");
+    }
+
+    // Records the state of container from the next capture on
+    template <typename Component>
+    void track(ComponentContainer<Component>& container)
+    {
+        TINYECS_CHECK(count == 0, "Track all containers before the first capture");
+        pools.emplace_back(new HistoryPool<Component>(container, capacity));
+    }
+
+    // Records the current state of all tracked containers, overwriting the oldest capture when the ring buffer is full
+    void capture()
+    {
+        size_t slot = count == 0 ? 0 : (latest + 1) % capacity;
+        for (auto& pool : pools)
+            pool->capture(slot);
+        latest = slot;
+        count = std::min(count + 1, capacity);
+    }
+
+    // Restores the state of the capture 'ticks' captures before the latest one, rewind(0) drops the changes since the latest capture
+    // The later captures are discarded, such that the resimulated ticks are captured again
+    void rewind(size_t ticks)
+    {
+        TINYECS_CHECK(ticks < count, "Rewinding further than the captured ticks");
+        size_t slot = (latest + capacity - ticks) % capacity;
+        for (auto& pool : pools)
+            pool->restore(slot, latest);
+        latest = slot;
+        count -= ticks;
+    }
+
+    // Number of captures that can be restored
+    size_t size()
+    {
+        return count;
+    }
+
+    // The memory of all captures in bytes, chunks shared by several captures are counted once
+    size_t bytes()
+    {
+        size_t result = 0;
+        for (auto& pool : pools)
+            result += pool->bytes();
+        return result;
+    }
+};
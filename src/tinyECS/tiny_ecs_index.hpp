@@ -0,0 +1,204 @@
+#pragma once
+
+#include "tiny_ecs.hpp"
+#include <map>
+
+// Secondary indices that find entities by the value of a component field, e.g., the entity named "Turtle"
+// An index observes its container and is kept up to date on insert(), remove(), patch(), and clear()
+// Note, changes made through get() or by writing to 'components' directly are not observed, use patch() instead
+
+// A hash index for lookups by equality, the Key type must be hashable with std::hash
+template <typename Component, typename Key>
+class HashIndex : public ContainerObserver
+{
+private:
+    // Where an entity is listed in the index
+    struct Slot
+    {
+        Key key;
+        unsigned int position; // position in map_key_entities[key]
+    };
+
+    ComponentContainer<Component>& container;
+    Key Component::* field;
+    std::unordered_map<Key, std::vector<Entity>> map_key_entities;
+    std::unordered_map<unsigned int, Slot> map_entity_slot; // the entity is cast to uint to be hashable.
+    std::vector<Entity> no_entities;
+
+    void add(Entity e, const Key& key)
+    {
+        std::vector<Entity>& list = map_key_entities[key];
+        map_entity_slot[e] = Slot{ key, (unsigned int)list.size() };
+        list.push_back(e);
+    }
+
+    void erase(Entity e)
+    {
+        auto slot = map_entity_slot.find(e);
+        std::vector<Entity>& list = map_key_entities[slot->second.key];
+
+        // Move the last entity of the list to the position of e
+        list[slot->second.position] = list.back();
+        map_entity_slot[list.back()].position = slot->second.position;
+        list.pop_back();
+        if (list.empty())
+            map_key_entities.erase(slot->second.key);
+        map_entity_slot.erase(slot);
+    }
+public:
+    // Indexes container.components[i].*field, e.g., HashIndex<Name, InternedString> index(registry.names, &Name::name)
+    HashIndex(ComponentContainer<Component>& container, Key Component::* field) : container(container), field(field)
+    {
+        for (size_t i = 0; i < container.components.size(); i++)
+            add(container.entities[i], container.components[i].*field);
+        container.connect(this);
+    }
+
+    ~HashIndex()
+    {
+        container.disconnect(this);
+    }
+
+    HashIndex(const HashIndex&) = delete;
+    HashIndex& operator=(const HashIndex&) = delete;
+
+    // All entities whose field equals key
+    const std::vector<Entity>& find_all(const Key& key)
+    {
+        auto it = map_key_entities.find(key);
+        return it == map_key_entities.end() ? no_entities : it->second;
+    }
+
+    // Returns one entity whose field equals key, nullptr if there is none
+    const Entity* find(const Key& key)
+    {
+        auto it = map_key_entities.find(key);
+        return it == map_key_entities.end() ? nullptr : &it->second.front();
+    }
+
+    // Report the number of distinct keys
+    size_t size()
+    {
+        return map_key_entities.size();
+    }
+
+    void on_insert(ContainerInterface&, Entity e, unsigned int index)
+    {
+        add(e, container.components[index].*field);
+    }
+
+    void on_remove(ContainerInterface&, Entity e, unsigned int)
+    {
+        erase(e);
+    }
+
+    void on_patch(ContainerInterface&, Entity e, unsigned int index)
+    {
+        const Key& key = container.components[index].*field;
+        if (map_entity_slot[e].key == key)
+            return;
+        erase(e);
+        add(e, key);
+    }
+
+    void on_clear(ContainerInterface&)
+    {
+        map_key_entities.clear();
+        map_entity_slot.clear();
+    }
+};
+
+// An ordered index for range queries, the Key type must be comparable with operator<
+template <typename Component, typename Key>
+class OrderedIndex : public ContainerObserver
+{
+private:
+    typedef std::multimap<Key, Entity> Map;
+
+    ComponentContainer<Component>& container;
+    Key Component::* field;
+    Map map_key_entity;
+    std::unordered_map<unsigned int, typename Map::iterator> map_entity_iterator; // the entity is cast to uint to be hashable.
+
+    void add(Entity e, const Key& key)
+    {
+        map_entity_iterator[e] = map_key_entity.emplace(key, e);
+    }
+
+    void erase(Entity e)
+    {
+        auto it = map_entity_iterator.find(e);
+        map_key_entity.erase(it->second);
+        map_entity_iterator.erase(it);
+    }
+public:
+    // Indexes container.components[i].*field, e.g., OrderedIndex<Walks, float> index(registry.walks, &Walks::walk_speed)
+    OrderedIndex(ComponentContainer<Component>& container, Key Component::* field) : container(container), field(field)
+    {
+        for (size_t i = 0; i < container.components.size(); i++)
+            add(container.entities[i], container.components[i].*field);
+        container.connect(this);
+    }
+
+    ~OrderedIndex()
+    {
+        container.disconnect(this);
+    }
+
+    OrderedIndex(const OrderedIndex&) = delete;
+    OrderedIndex& operator=(const OrderedIndex&) = delete;
+
+    // Returns one entity whose field equals key, nullptr if there is none
+    const Entity* find(const Key& key)
+    {
+        auto it = map_key_entity.find(key);
+        return it == map_key_entity.end() ? nullptr : &it->second;
+    }
+
+    // Calls f(Entity) for all entities with min <= field < max, in ascending order of the field
+    template<typename F>
+    void each_in_range(const Key& min, const Key& max, F f)
+    {
+        auto end = map_key_entity.lower_bound(max);
+        for (auto it = map_key_entity.lower_bound(min); it != end; ++it)
+            f(it->second);
+    }
+
+    // Appends all entities with min <= field < max to result, in ascending order of the field
+    void range(const Key& min, const Key& max, std::vector<Entity>& result)
+    {
+        each_in_range(min, max, [&result](Entity e) { result.push_back(e); });
+    }
+
+    // Report the number of indexed entities
+    size_t size()
+    {
+        return map_key_entity.size();
+    }
+
+    void on_insert(ContainerInterface&, Entity e, unsigned int index)
+    {
+        add(e, container.components[index].*field);
+    }
+
+    void on_remove(ContainerInterface&, Entity e, unsigned int)
+    {
+        erase(e);
+    }
+
+    void on_patch(ContainerInterface&, Entity e, unsigned int index)
+    {
+        const Key& key = container.components[index].*field;
+        const Key& old_key = map_entity_iterator[e]->first;
+        if (!(key < old_key) && !(old_key < key))
+            return;
+        erase(e);
+        add(e, key);
+    }
+
+    void on_clear(ContainerInterface&)
+    {
+        map_key_entity.clear();
+        map_entity_iterator.clear();
+    }
+};
@@ -0,0 +1,482 @@
+#pragma once
+
+#include "tiny_ecs.hpp"
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+
+// Memory-mapped worlds that are used in place instead of being re-inserted component by component
+// MappedWorldWriter stores the dense entities and components arrays of containers of trivially copyable components,
+// together with an open addressing index from entity to position, each array page aligned in one file.
+// MappedWorld maps the file privately and MappedContainer serves the pools in place, such that loading is independent
+// of the entity count. Writes to components, e.g., through get() or patch(), only copy the touched pages (copy-on-write),
+// while the first insert(), remove(), or clear() copies the pool to the heap.
+//     MappedWorldWriter writer;
+//     writer.add(registry.positions);
+//     writer.write("level.tecs");
+//     MappedWorld world;
+//     world.open("level.tecs");
+//     MappedContainer<Position> positions(world, 0); // the pools in the order they were added
+// Note, compile tiny_ecs_mapped.cpp together with tiny_ecs.cpp to use it.
+
+/////////////////////////////////////////
+// File format
+
+// Pools start at multiples of the page size, on all platforms
+static const uint64_t mapped_page_size = 4096;
+
+struct MappedWorldHeader
+{
+    char magic[8]; // "tinyECS"
+    uint32_t version;
+    uint32_t pool_count;
+    uint32_t next_entity_id; // Entity::next_id() when the world was written
+    uint32_t reserved;
+};
+
+// Followed by pool_count MappedPoolHeaders, the offsets are relative to the start of the file
+struct MappedPoolHeader
+{
+    uint64_t component_size;
+    uint64_t component_alignment;
+    uint64_t count;
+    uint64_t index_capacity; // a power of two
+    uint64_t entities_offset;
+    uint64_t components_offset;
+    uint64_t index_offset;
+};
+
+// An entry of the open addressing index, entity 0 marks an empty slot
+struct MappedIndexSlot
+{
+    uint32_t entity;
+    uint32_t position;
+};
+
+// The index is at most half full to keep the probe sequences short
+inline uint64_t mapped_index_capacity(uint64_t count)
+{
+    uint64_t capacity = 16;
+    while (capacity < 2 * count)
+        capacity *= 2;
+    return capacity;
+}
+
+// The first slot to probe for entity id, Fibonacci hashing spreads consecutive ids
+inline uint64_t mapped_index_home(uint32_t id, uint64_t capacity)
+{
+    return (uint32_t)(id * 2654435761u) & (capacity - 1);
+}
+
+// The slot of id, or of the empty slot that ends its probe sequence
+inline uint64_t mapped_index_probe(const MappedIndexSlot* slots, uint64_t capacity, uint32_t id)
+{
+    uint64_t i = mapped_index_home(id, capacity);
+    while (slots[i].entity != 0 && slots[i].entity != id)
+        i = (i + 1) & (capacity - 1);
+    return i;
+}
+
+/////////////////////////////////////////
+// Writing
+
+// Collects containers and writes them as one mapped world file
+class MappedWorldWriter
+{
+    // Writes the arrays of a pool, knowing the component type
+    struct PoolSource
+    {
+        virtual ~PoolSource() {}
+        virtual const void* entities() = 0;
+        virtual const void* components() = 0;
+        virtual size_t count() = 0;
+        virtual size_t component_size() = 0;
+        virtual size_t component_alignment() = 0;
+    };
+
+    template <typename Component>
+    struct ContainerSource : PoolSource
+    {
+        ComponentContainer<Component>& container;
+        ContainerSource(ComponentContainer<Component>& container) : container(container) {}
+        const void* entities() override { return container.entities.data(); }
+        const void* components() override { return container.components.data(); }
+        size_t count() override { return container.components.size(); }
+        size_t component_size() override { return sizeof(Component); }
+        size_t component_alignment() override { return alignof(Component); }
+    };
+
+    std::vector<std::unique_ptr<PoolSource>> sources;
+
+    static bool pad(FILE* file, uint64_t& offset, uint64_t target)
+    {
+        static const char zeros[mapped_page_size] = {};
+        while (offset < target)
+        {
+            size_t n = (size_t)std::min(target - offset, mapped_page_size);
+            if (fwrite(zeros, 1, n, file) != n)
+                return false;
+            offset += n;
+        }
+        return true;
+    }
+
+    static bool put(FILE* file, uint64_t& offset, const void* data, size_t bytes)
+    {
+        offset += bytes;
+        return bytes == 0 || fwrite(data, 1, bytes, file) == bytes;
+    }
+
+    static uint64_t page_align(uint64_t offset)
+    {
+        return (offset + mapped_page_size - 1) / mapped_page_size * mapped_page_size;
+    }
+public:
+    // Adds the pool of container, which is referenced until write()
+    template <typename Component>
+    void add(ComponentContainer<Component>& container)
+    {
+        static_assert(std::is_trivially_copyable<Component>::value, "Only containers of trivially copyable components can be mapped");
+        sources.emplace_back(new ContainerSource<Component>(container));
+    }
+
+    // Writes all added pools, returns false if the file can't be written
+    bool write(const char* path)
+    {
+        MappedWorldHeader header = {};
+        memcpy(header.magic, "tinyECS", 8);
+        header.version = 1;
+        header.pool_count = (uint32_t)sources.size();
+        header.next_entity_id = Entity::next_id();
+
+        // Lay out the arrays of all pools, each starting at a page
+        std::vector<MappedPoolHeader> pools(sources.size());
+        uint64_t end = page_align(sizeof(MappedWorldHeader) + pools.size() * sizeof(MappedPoolHeader));
+        for (size_t p = 0; p < sources.size(); p++)
+        {
+            MappedPoolHeader& pool = pools[p];
+            pool.component_size = sources[p]->component_size();
+            pool.component_alignment = sources[p]->component_alignment();
+            pool.count = sources[p]->count();
+            pool.index_capacity = mapped_index_capacity(pool.count);
+            pool.entities_offset = end;
+            pool.components_offset = page_align(pool.entities_offset + pool.count * sizeof(Entity));
+            pool.index_offset = page_align(pool.components_offset + pool.count * pool.component_size);
+            end = page_align(pool.index_offset + pool.index_capacity * sizeof(MappedIndexSlot));
+        }
+
+        FILE* file = fopen(path, "wb");
+        if (!file)
+            return false;
+        uint64_t offset = 0;
+        bool ok = put(file, offset, &header, sizeof(header)) && put(file, offset, pools.data(), pools.size() * sizeof(MappedPoolHeader));
+        std::vector<MappedIndexSlot> index;
+        for (size_t p = 0; p < sources.size() && ok; p++)
+        {
+            const MappedPoolHeader& pool = pools[p];
+            const Entity* entities = static_cast<const Entity*>(sources[p]->entities());
+            index.assign((size_t)pool.index_capacity, MappedIndexSlot{ 0, 0 });
+            for (uint64_t i = 0; i < pool.count; i++)
+                index[(size_t)mapped_index_probe(index.data(), pool.index_capacity, entities[i])] = MappedIndexSlot{ entities[i], (uint32_t)i };
+
+            ok = pad(file, offset, pool.entities_offset) && put(file, offset, entities, (size_t)pool.count * sizeof(Entity))
+                && pad(file, offset, pool.components_offset) && put(file, offset, sources[p]->components(), (size_t)(pool.count * pool.component_size))
+                && pad(file, offset, pool.index_offset) && put(file, offset, index.data(), index.size() * sizeof(MappedIndexSlot));
+        }
+        ok = ok && pad(file, offset, end);
+        return fclose(file) == 0 && ok;
+    }
+};
+
+/////////////////////////////////////////
+// Loading
+
+// A private, writable mapping of a whole file, writes are never written back to the file
+class MappedFile
+{
+    void* data = nullptr;
+    size_t bytes = 0;
+#ifdef _WIN32
+    void* file_handle = nullptr;
+    void* mapping_handle = nullptr;
+#endif
+public:
+    MappedFile() {}
+    ~MappedFile() { close(); }
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // Maps the file copy-on-write, returns false if it can't be opened or is empty
+    bool open(const char* path);
+    void close();
+
+    uint8_t* begin() const { return static_cast<uint8_t*>(data); }
+    size_t size() const { return bytes; }
+};
+
+// The pools of a file written by MappedWorldWriter, the world must outlive the MappedContainers that use it
+class MappedWorld
+{
+public:
+    MappedFile file;
+
+    // Maps the file and reserves the entity ids used in it, returns false if it isn't a valid world file
+    bool open(const char* path)
+    {
+        if (!file.open(path))
+            return false;
+        if (!valid())
+        {
+            file.close();
+            return false;
+        }
+        Entity::reserve_ids(header().next_entity_id);
+        return true;
+    }
+
+    const MappedWorldHeader& header() const
+    {
+        return *reinterpret_cast<const MappedWorldHeader*>(file.begin());
+    }
+
+    const MappedPoolHeader& pool(size_t p) const
+    {
+        TINYECS_CHECK(p < header().pool_count, "Pool not contained in the mapped world");
+        return reinterpret_cast<const MappedPoolHeader*>(file.begin() + sizeof(MappedWorldHeader))[p];
+    }
+
+    size_t pool_count() const
+    {
+        return file.begin() ? header().pool_count : 0;
+    }
+
+    // Checks if pool p exists and its components have the size and alignment of Component, e.g., before serving it
+    template <typename Component>
+    bool holds(size_t p) const
+    {
+        return p < pool_count() && pool(p).component_size == sizeof(Component) && pool(p).component_alignment == alignof(Component);
+    }
+private:
+    // Checks that the headers fit the file, the contents of the pools are trusted
+    bool valid() const
+    {
+        if (file.size() < sizeof(MappedWorldHeader) || memcmp(header().magic, "tinyECS", 8) != 0 || header().version != 1)
+            return false;
+        if (file.size() < sizeof(MappedWorldHeader) + header().pool_count * sizeof(MappedPoolHeader))
+            return false;
+        for (size_t p = 0; p < header().pool_count; p++)
+        {
+            const MappedPoolHeader& pool = this->pool(p);
+            if (pool.entities_offset % mapped_page_size || pool.components_offset % mapped_page_size || pool.index_offset % mapped_page_size
+                || pool.entities_offset + pool.count * sizeof(Entity) > file.size()
+                || pool.components_offset + pool.count * pool.component_size > file.size()
+                || pool.index_offset + pool.index_capacity * sizeof(MappedIndexSlot) > file.size()
+                || pool.index_capacity < 2 * pool.count || (pool.index_capacity & (pool.index_capacity - 1)))
+                return false;
+        }
+        return true;
+    }
+};
+
+// A container that serves a pool of a MappedWorld in place, with the interface of ComponentContainer
+// Reads and writes of components use the mapped pages, the first structural change copies the pool to the heap.
+template <typename Component>
+class MappedContainer : public ContainerInterface
+{
+private:
+    // Heap copies of the pool, used once detached from the mapping
+    std::vector<Entity> entity_storage;
+    std::vector<Component> component_storage;
+    std::vector<MappedIndexSlot> index_storage;
+
+    MappedIndexSlot* index = nullptr;
+    uint64_t index_capacity = 0;
+    size_t count = 0;
+
+    // Copies the pool to the heap, such that it can grow and shrink
+    void detach()
+    {
+        if (!mapped)
+            return;
+        entity_storage.assign(entities, entities + count);
+        component_storage.assign(components, components + count);
+        index_storage.assign(index, index + index_capacity);
+        point_to_storage();
+        mapped = false;
+    }
+
+    void point_to_storage()
+    {
+        entities = entity_storage.data();
+        components = component_storage.data();
+        index = index_storage.data();
+        index_capacity = index_storage.size();
+    }
+
+    // Doubles the index once it is half full
+    void grow_index()
+    {
+        std::vector<MappedIndexSlot> slots((size_t)index_capacity * 2, MappedIndexSlot{ 0, 0 });
+        for (size_t i = 0; i < count; i++)
+            slots[(size_t)mapped_index_probe(slots.data(), slots.size(), entities[i])] = MappedIndexSlot{ entities[i], (uint32_t)i };
+        index_storage.swap(slots);
+        point_to_storage();
+    }
+
+    // Empties slot i and moves later entries of the probe sequence back, such that they stay reachable
+    void erase_slot(uint64_t i)
+    {
+        uint64_t mask = index_capacity - 1;
+        for (uint64_t j = (i + 1) & mask; index[j].entity != 0; j = (j + 1) & mask)
+        {
+            uint64_t home = mapped_index_home(index[j].entity, index_capacity);
+            // Move entry j to i unless its home lies cyclically in (i, j]
+            bool stays = i <= j ? (i < home && home <= j) : (i < home || home <= j);
+            if (!stays)
+            {
+                index[i] = index[j];
+                i = j;
+            }
+        }
+        index[i].entity = 0;
+    }
+
+    const MappedIndexSlot* find(Entity e)
+    {
+        const MappedIndexSlot& slot = index[mapped_index_probe(index, index_capacity, e)];
+        return slot.entity ? &slot : nullptr;
+    }
+public:
+    // The dense arrays, entities[i] is the entity of components[i] for i < size()
+    // Note, the pointers change when the pool is detached or grows
+    Entity* entities = nullptr;
+    Component* components = nullptr;
+    bool mapped = false; // true while the arrays are the mapped pages
+
+    // Serves pool p of world, which must hold Components, see MappedWorld::holds()
+    MappedContainer(MappedWorld& world, size_t p)
+    {
+        static_assert(std::is_trivially_copyable<Component>::value, "Only containers of trivially copyable components can be mapped");
+        TINYECS_CHECK(world.holds<Component>(p), "Pool of another component type");
+        const MappedPoolHeader& pool = world.pool(p);
+        uint8_t* begin = world.file.begin();
+        entities = reinterpret_cast<Entity*>(begin + pool.entities_offset);
+        components = reinterpret_cast<Component*>(begin + pool.components_offset);
+        index = reinterpret_cast<MappedIndexSlot*>(begin + pool.index_offset);
+        index_capacity = pool.index_capacity;
+        count = (size_t)pool.count;
+        mapped = true;
+    }
+
+    MappedContainer(const MappedContainer&) = delete;
+    MappedContainer& operator=(const MappedContainer&) = delete;
+
+    // Inserting a component c associated to entity e
+    Component& insert(Entity e, Component c, bool check_for_duplicates = true)
+    {
+        assert(!(check_for_duplicates && find(e)) && "Entity already contained in ECS registry");
+        (void)check_for_duplicates;
+        detach();
+        TINYECS_COUNT(inserts);
+        if (2 * (count + 1) > index_capacity)
+            grow_index();
+        index[mapped_index_probe(index, index_capacity, e)] = MappedIndexSlot{ e, (uint32_t)count };
+        entity_storage.push_back(e);
+        component_storage.push_back(c);
+        point_to_storage();
+        count++;
+        if (!observers.empty())
+            notify_insert(e, (unsigned int)count - 1);
+        return components[count - 1];
+    }
+
+    template<typename... Args>
+    Component& emplace(Entity e, Args &&... args) {
+        return insert(e, Component(std::forward<Args>(args)...));
+    };
+
+    // A wrapper to return the component of an entity
+    Component& get(Entity e) {
+        const MappedIndexSlot* slot = find(e);
+        TINYECS_CHECK(slot, "Entity not contained in ECS registry");
+        TINYECS_COUNT(gets);
+        return components[slot->position];
+    }
+
+    // Returns a pointer to the component of e or nullptr if e has none
+    Component* try_get(Entity e) {
+        TINYECS_COUNT(gets);
+        const MappedIndexSlot* slot = find(e);
+        return slot ? &components[slot->position] : nullptr;
+    }
+
+    // Changes the component of e with f(Component&) and notifies the observers
+    template<typename F>
+    Component& patch(Entity e, F f) {
+        Component& c = get(e);
+        f(c);
+        if (!observers.empty())
+            notify_patch(e, (unsigned int)(&c - components));
+        return c;
+    }
+
+    bool has(Entity entity) {
+        TINYECS_COUNT(hases);
+        return find(entity) != nullptr;
+    }
+
+    // Remove an component and pack the pool to re-use the empty space
+    void remove(Entity e)
+    {
+        if (!find(e))
+            return;
+        detach();
+        TINYECS_COUNT(removes);
+        uint64_t i = mapped_index_probe(index, index_capacity, e);
+        unsigned int position = index[i].position;
+        if (!observers.empty())
+            notify_remove(e, position);
+
+        // Move the last element to the position of e
+        Entity last = entity_storage.back();
+        component_storage[position] = component_storage.back();
+        entity_storage[position] = last;
+        index[mapped_index_probe(index, index_capacity, last)].position = position;
+        erase_slot(mapped_index_probe(index, index_capacity, e));
+        entity_storage.pop_back();
+        component_storage.pop_back();
+        point_to_storage();
+        count--;
+    }
+
+    void clear()
+    {
+        if (!observers.empty())
+            notify_clear();
+        mapped = false;
+        entity_storage.clear();
+        component_storage.clear();
+        index_storage.assign((size_t)mapped_index_capacity(0), MappedIndexSlot{ 0, 0 });
+        point_to_storage();
+        count = 0;
+    }
+
+    size_t size()
+    {
+        return count;
+    }
+
+    // Report the memory use, mapped pools don't reserve heap memory
+    ContainerStats stats()
+    {
+        ContainerStats result = operation_counts.stats();
+        result.count = count;
+        result.bytes_used = count * (sizeof(Component) + sizeof(Entity));
+        result.bytes_reserved = component_storage.capacity() * sizeof(Component) + entity_storage.capacity() * sizeof(Entity);
+        result.index_bytes = mapped ? 0 : index_storage.capacity() * sizeof(MappedIndexSlot);
+        result.index_buckets = (size_t)index_capacity;
+        result.load_factor = index_capacity ? (float)count / index_capacity : 0.f;
+        return result;
+    }
+};
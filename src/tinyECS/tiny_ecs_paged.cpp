@@ -0,0 +1,126 @@
+// internal
+#include "tiny_ecs_paged.hpp"
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+bool SwapFile::open(const char* path)
+{
+    close();
+    // The system deletes the file when the last handle is closed
+    HANDLE created = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS,
+        FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE, nullptr);
+    if (created == INVALID_HANDLE_VALUE)
+        return false;
+    handle = created;
+    return true;
+}
+
+void SwapFile::close()
+{
+    if (handle)
+        CloseHandle(handle);
+    handle = nullptr;
+}
+
+bool SwapFile::is_open() const
+{
+    return handle != nullptr;
+}
+
+bool SwapFile::write(uint64_t offset, const void* data, size_t bytes)
+{
+    const char* source = static_cast<const char*>(data);
+    while (bytes > 0)
+    {
+        OVERLAPPED position = {};
+        position.Offset = (DWORD)offset;
+        position.OffsetHigh = (DWORD)(offset >> 32);
+        DWORD written = 0;
+        DWORD chunk = (DWORD)std::min<size_t>(bytes, 1u << 30);
+        if (!WriteFile(handle, source, chunk, &written, &position) || written == 0)
+            return false;
+        source += written;
+        offset += written;
+        bytes -= written;
+    }
+    return true;
+}
+
+bool SwapFile::read(uint64_t offset, void* data, size_t bytes)
+{
+    char* target = static_cast<char*>(data);
+    while (bytes > 0)
+    {
+        OVERLAPPED position = {};
+        position.Offset = (DWORD)offset;
+        position.OffsetHigh = (DWORD)(offset >> 32);
+        DWORD read = 0;
+        DWORD chunk = (DWORD)std::min<size_t>(bytes, 1u << 30);
+        if (!ReadFile(handle, target, chunk, &read, &position) || read == 0)
+            return false;
+        target += read;
+        offset += read;
+        bytes -= read;
+    }
+    return true;
+}
+#else
+bool SwapFile::open(const char* path)
+{
+    close();
+    file = ::open(path, O_RDWR | O_CREAT | O_TRUNC, 0600);
+    if (file < 0)
+        return false;
+    unlink(path); // the file is deleted when it is closed
+    return true;
+}
+
+void SwapFile::close()
+{
+    if (file >= 0)
+        ::close(file);
+    file = -1;
+}
+
+bool SwapFile::is_open() const
+{
+    return file >= 0;
+}
+
+bool SwapFile::write(uint64_t offset, const void* data, size_t bytes)
+{
+    const char* source = static_cast<const char*>(data);
+    while (bytes > 0)
+    {
+        ssize_t written = pwrite(file, source, bytes, (off_t)offset);
+        if (written <= 0)
+            return false;
+        source += written;
+        offset += written;
+        bytes -= written;
+    }
+    return true;
+}
+
+bool SwapFile::read(uint64_t offset, void* data, size_t bytes)
+{
+    char* target = static_cast<char*>(data);
+    while (bytes > 0)
+    {
+        ssize_t read = pread(file, target, bytes, (off_t)offset);
+        if (read <= 0)
+            return false;
+        target += read;
+        offset += read;
+        bytes -= read;
+    }
+    return true;
+}
+#endif
@@ -0,0 +1,360 @@
+#pragma once
+
+#include "tiny_ecs.hpp"
+#include <cstdint>
+#include <cstring>
+#include <memory>
+
+// Out-of-core containers for worlds with more components than fit in memory, e.g., the dormant entities of a persistent server
+// PagedContainer stores the components in chunks and keeps only the most recently accessed chunks in memory, within a
+// budget of bytes. The least recently accessed chunks are written to a swap file and read back when their components
+// are accessed or iterated again. The entities and the lookup stay in memory, 8 bytes per entity.
+//     PagedContainer<Position> positions("positions.swap", 256 << 20); // 256 MiB of components in memory
+//     positions.insert(e, Position{ 0, 0 });
+//     positions.get(e).x += 1; // reads the chunk of e back if it was evicted
+//     positions.each_const([](Entity e, const Position& p) { ... }); // one chunk after the other
+// Note, a reference to a component is only valid until the next access to another chunk, which may evict it.
+// Note, the chunks are raw storage that is filled by copies of the inserted components, no default constructor is needed.
+// Note, compile tiny_ecs_paged.cpp together with tiny_ecs.cpp to use it.
+
+// A scratch file for evicted chunks, it is deleted when closed
+class SwapFile
+{
+    int file = -1;
+#ifdef _WIN32
+    void* handle = nullptr;
+#endif
+public:
+    SwapFile() {}
+    ~SwapFile() { close(); }
+    SwapFile(const SwapFile&) = delete;
+    SwapFile& operator=(const SwapFile&) = delete;
+
+    // Creates or truncates the file, returns false if it can't be created
+    bool open(const char* path);
+    void close();
+    bool is_open() const;
+
+    // Positional reads and writes, return false on failure
+    bool write(uint64_t offset, const void* data, size_t bytes);
+    bool read(uint64_t offset, void* data, size_t bytes);
+};
+
+// The paging activity of a PagedContainer
+struct PagingStats
+{
+    size_t chunks = 0;
+    size_t resident_chunks = 0;
+    size_t faults = 0; // chunks read back from the swap file
+    size_t evictions = 0;
+    size_t writes = 0; // evictions of changed chunks, the others are still current in the swap file
+};
+
+template <typename Component>
+class PagedContainer : public ContainerInterface
+{
+    static_assert(std::is_trivially_copyable<Component>::value, "Paged components are written to the swap file as bytes");
+
+    static const size_t none = (size_t)-1;
+
+    // Frees the raw storage of a chunk, the components are trivially destructible
+    struct ChunkDeleter
+    {
+        size_t bytes = 0;
+        void operator()(Component* components) const
+        {
+            aligned_free(components, bytes, alignof(Component), false);
+        }
+    };
+
+    struct Chunk
+    {
+        std::unique_ptr<Component[], ChunkDeleter> components; // nullptr while evicted
+        size_t older = none; // the neighbours in the list of resident chunks, from the least to the most recently accessed
+        size_t newer = none;
+        bool dirty = true; // changed since it was last written to the swap file
+        bool swapped = false; // the swap file holds a copy
+    };
+
+    SwapFile swap_file;
+    std::vector<Chunk> chunks;
+    SparseIndex index;
+    size_t chunk_capacity;
+    size_t memory_budget;
+    size_t resident = 0; // chunks in memory
+    size_t oldest = none; // the ends of the list of resident chunks, the oldest is evicted first
+    size_t newest = none;
+
+    size_t chunk_bytes() const
+    {
+        return chunk_capacity * sizeof(Component);
+    }
+
+    // The maximal number of chunks in memory, at least two for the moves of remove()
+    size_t resident_limit() const
+    {
+        return std::max<size_t>(2, memory_budget / chunk_bytes());
+    }
+
+    void unlink(size_t c)
+    {
+        Chunk& chunk = chunks[c];
+        (chunk.older == none ? oldest : chunks[chunk.older].newer) = chunk.newer;
+        (chunk.newer == none ? newest : chunks[chunk.newer].older) = chunk.older;
+        chunk.older = chunk.newer = none;
+    }
+
+    void link_newest(size_t c)
+    {
+        Chunk& chunk = chunks[c];
+        chunk.older = newest;
+        chunk.newer = none;
+        (newest == none ? oldest : chunks[newest].newer) = c;
+        newest = c;
+    }
+
+    void evict(size_t c)
+    {
+        TINYECS_ZONE("PagedContainer::evict");
+        unlink(c);
+        Chunk& chunk = chunks[c];
+        if (chunk.dirty || !chunk.swapped)
+        {
+            if (!swap_file.write((uint64_t)c * chunk_bytes(), chunk.components.get(), chunk_bytes()))
+                tinyecs_check_failed("Writing to the swap file failed", __FILE__, __LINE__);
+            chunk.swapped = true;
+            chunk.dirty = false;
+            stats_paging.writes++;
+        }
+        chunk.components.reset();
+        resident--;
+        stats_paging.evictions++;
+    }
+
+    // Evicts the least recently accessed chunks other than 'keep' until 'needed' more chunks fit into the budget, O(1) per eviction
+    void make_room(size_t keep, size_t needed = 1)
+    {
+        while (resident + needed > resident_limit())
+        {
+            size_t victim = oldest == keep ? chunks[keep].newer : oldest;
+            if (victim == none)
+                return;
+            evict(victim);
+        }
+    }
+
+    // Makes chunk c resident and the most recently accessed one, 'keep' is another chunk that must stay in memory
+    Component* touch(size_t c, bool write, size_t keep = none)
+    {
+        Chunk& chunk = chunks[c];
+        if (!chunk.components)
+        {
+            TINYECS_ZONE("PagedContainer::fault");
+            make_room(keep);
+            ChunkDeleter deleter;
+            deleter.bytes = chunk_bytes();
+            chunk.components = std::unique_ptr<Component[], ChunkDeleter>(
+                static_cast<Component*>(aligned_allocate(chunk_bytes(), alignof(Component), false)), deleter);
+            resident++;
+            link_newest(c);
+            if (chunk.swapped)
+            {
+                if (!swap_file.read((uint64_t)c * chunk_bytes(), chunk.components.get(), chunk_bytes()))
+                    tinyecs_check_failed("Reading from the swap file failed", __FILE__, __LINE__);
+                stats_paging.faults++;
+            }
+        }
+        else if (newest != c)
+        {
+            unlink(c);
+            link_newest(c);
+        }
+        chunk.dirty |= write;
+        return chunk.components.get();
+    }
+
+    Component& at(size_t position, bool write, size_t keep = none)
+    {
+        return touch(position / chunk_capacity, write, keep)[position % chunk_capacity];
+    }
+
+    PagingStats stats_paging;
+public:
+    // The entities of the components, in the order of the chunks
+    EntityArray entities;
+
+    // Components are paged in chunks of chunk_capacity, by default about 64 KiB
+    PagedContainer(const char* swap_path, size_t memory_budget, size_t chunk_capacity = 0)
+        : chunk_capacity(chunk_capacity ? chunk_capacity : std::max<size_t>(1, 65536 / sizeof(Component))), memory_budget(memory_budget)
+    {
+        TINYECS_CHECK(swap_file.open(swap_path), "The swap file can't be created");
+    }
+
+    PagedContainer(const PagedContainer&) = delete;
+    PagedContainer& operator=(const PagedContainer&) = delete;
+
+    // Changes the bytes of components in memory, evicting chunks right away if they no longer fit
+    void set_memory_budget(size_t bytes)
+    {
+        memory_budget = bytes;
+        make_room(none, 0);
+    }
+
+    Component& insert(Entity e, Component c)
+    {
+        TINYECS_CHECK(!index.contains(e), "Entity already contained in ECS registry");
+        TINYECS_COUNT(inserts);
+        size_t position = entities.size();
+        if (position / chunk_capacity == chunks.size())
+            chunks.emplace_back();
+        Component* component = new (&at(position, true)) Component(c);
+        entities.push_back(e);
+        index.set(e, (unsigned int)position);
+        if (!observers.empty())
+            notify_insert(e, (unsigned int)position);
+        return *component;
+    }
+
+    template<typename... Args>
+    Component& emplace(Entity e, Args &&... args) {
+        return insert(e, Component(std::forward<Args>(args)...));
+    };
+
+    // The component of e, its chunk is read back if it was evicted and is written to the swap file on the next eviction
+    Component& get(Entity e)
+    {
+        TINYECS_COUNT(gets);
+        unsigned int position = index.find(e);
+        TINYECS_CHECK(position != SparseIndex::empty, "Entity not contained in ECS registry");
+        return at(position, true);
+    }
+
+    // The component of e for reading, its chunk isn't written again when evicted
+    const Component& read(Entity e)
+    {
+        TINYECS_COUNT(gets);
+        unsigned int position = index.find(e);
+        TINYECS_CHECK(position != SparseIndex::empty, "Entity not contained in ECS registry");
+        return at(position, false);
+    }
+
+    Component* try_get(Entity e)
+    {
+        TINYECS_COUNT(gets);
+        unsigned int position = index.find(e);
+        return position == SparseIndex::empty ? nullptr : &at(position, true);
+    }
+
+    // Checks the lookup in memory, without reading the chunk
+    bool has(Entity e)
+    {
+        TINYECS_COUNT(hases);
+        return index.contains(e);
+    }
+
+    // Moves the last component to the position of e, reading both chunks if needed
+    void remove(Entity e)
+    {
+        unsigned int position = index.find(e);
+        if (position == SparseIndex::empty)
+            return;
+        TINYECS_COUNT(removes);
+        if (!observers.empty())
+            notify_remove(e, position);
+        size_t last = entities.size() - 1;
+        if (position != last)
+        {
+            Component& target = at(position, true);
+            target = at(last, false, position / chunk_capacity);
+            entities[position] = entities[last];
+            index.set(entities[position], position);
+        }
+        index.erase(e);
+        entities.pop_back();
+        if (last % chunk_capacity == 0)
+        {
+            // The last chunk is empty
+            if (chunks.back().components)
+            {
+                unlink(chunks.size() - 1);
+                resident--;
+            }
+            chunks.pop_back();
+        }
+    }
+
+    // Calls f(Entity, Component&) for all components, chunk by chunk
+    // Note, don't insert or remove components while iterating
+    template <typename F>
+    void each(F f)
+    {
+        each_impl(f, true);
+    }
+
+    // Calls f(Entity, const Component&) for all components, the chunks aren't written again when evicted
+    template <typename F>
+    void each_const(F f)
+    {
+        each_impl(f, false);
+    }
+
+    void clear()
+    {
+        if (!observers.empty())
+            notify_clear();
+        chunks.clear();
+        entities.clear();
+        index.clear();
+        resident = 0;
+        oldest = newest = none;
+    }
+
+    size_t size()
+    {
+        return entities.size();
+    }
+
+    // Bytes of the components in memory
+    size_t resident_bytes() const
+    {
+        return resident * chunk_bytes();
+    }
+
+    PagingStats paging_stats() const
+    {
+        PagingStats result = stats_paging;
+        result.chunks = chunks.size();
+        result.resident_chunks = resident;
+        return result;
+    }
+
+    ContainerStats stats()
+    {
+        ContainerStats result = operation_counts.stats();
+        result.count = entities.size();
+        result.bytes_used = resident_bytes() + entities.size() * sizeof(Entity);
+        result.bytes_reserved = resident_bytes() + entities.capacity() * sizeof(Entity) + chunks.capacity() * sizeof(Chunk);
+        result.index_bytes = index.bytes();
+        return result;
+    }
+
+    void shrink_to_fit()
+    {
+        entities.shrink_to_fit();
+        chunks.shrink_to_fit();
+        index.shrink_to_fit();
+    }
+private:
+    template <typename F>
+    void each_impl(F& f, bool write)
+    {
+        TINYECS_ZONE("PagedContainer::each");
+        for (size_t c = 0; c < chunks.size(); c++)
+        {
+            Component* components = touch(c, write);
+            size_t begin = c * chunk_capacity, end = std::min(begin + chunk_capacity, entities.size());
+            for (size_t i = begin; i < end; i++)
+                f(entities[i], components[i - begin]);
+        }
+    }
+};
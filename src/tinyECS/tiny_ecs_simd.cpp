@@ -0,0 +1,203 @@
+// internal
+#include "tiny_ecs_simd.hpp"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define TINYECS_SIMD_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define TINYECS_TARGET_SSE2
+#define TINYECS_TARGET_AVX2
+#else
+#define TINYECS_TARGET_SSE2 __attribute__((target("sse2")))
+#define TINYECS_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+/////////////////////////////////////////
+// Scalar kernels, also used for strided spans and the remainder of the vectorized loops
+
+static void axpy_scalar(float a, FloatSpan x, FloatSpan y, size_t begin)
+{
+    for (size_t i = begin; i < y.count; i++)
+        y[i] += a * x[i];
+}
+
+static void scale_scalar(FloatSpan x, float a, size_t begin)
+{
+    for (size_t i = begin; i < x.count; i++)
+        x[i] *= a;
+}
+
+static void clamp_scalar(FloatSpan x, float min, float max, size_t begin)
+{
+    for (size_t i = begin; i < x.count; i++)
+        x[i] = std::min(std::max(x[i], min), max);
+}
+
+#ifdef TINYECS_SIMD_X86
+/////////////////////////////////////////
+// SSE2 kernels, 4 floats at a time
+
+TINYECS_TARGET_SSE2 static void axpy_sse2(float a, FloatSpan x, FloatSpan y)
+{
+    __m128 va = _mm_set1_ps(a);
+    size_t i = 0;
+    for (; i + 4 <= y.count; i += 4)
+        _mm_storeu_ps(y.data + i, _mm_add_ps(_mm_loadu_ps(y.data + i), _mm_mul_ps(va, _mm_loadu_ps(x.data + i))));
+    axpy_scalar(a, x, y, i);
+}
+
+TINYECS_TARGET_SSE2 static void scale_sse2(FloatSpan x, float a)
+{
+    __m128 va = _mm_set1_ps(a);
+    size_t i = 0;
+    for (; i + 4 <= x.count; i += 4)
+        _mm_storeu_ps(x.data + i, _mm_mul_ps(_mm_loadu_ps(x.data + i), va));
+    scale_scalar(x, a, i);
+}
+
+TINYECS_TARGET_SSE2 static void clamp_sse2(FloatSpan x, float min, float max)
+{
+    __m128 vmin = _mm_set1_ps(min), vmax = _mm_set1_ps(max);
+    size_t i = 0;
+    for (; i + 4 <= x.count; i += 4)
+        _mm_storeu_ps(x.data + i, _mm_min_ps(_mm_max_ps(_mm_loadu_ps(x.data + i), vmin), vmax));
+    clamp_scalar(x, min, max, i);
+}
+
+/////////////////////////////////////////
+// AVX2 kernels, 8 floats at a time
+
+TINYECS_TARGET_AVX2 static void axpy_avx2(float a, FloatSpan x, FloatSpan y)
+{
+    __m256 va = _mm256_set1_ps(a);
+    size_t i = 0;
+    for (; i + 8 <= y.count; i += 8)
+        _mm256_storeu_ps(y.data + i, _mm256_add_ps(_mm256_loadu_ps(y.data + i), _mm256_mul_ps(va, _mm256_loadu_ps(x.data + i))));
+    axpy_scalar(a, x, y, i);
+}
+
+TINYECS_TARGET_AVX2 static void scale_avx2(FloatSpan x, float a)
+{
+    __m256 va = _mm256_set1_ps(a);
+    size_t i = 0;
+    for (; i + 8 <= x.count; i += 8)
+        _mm256_storeu_ps(x.data + i, _mm256_mul_ps(_mm256_loadu_ps(x.data + i), va));
+    scale_scalar(x, a, i);
+}
+
+TINYECS_TARGET_AVX2 static void clamp_avx2(FloatSpan x, float min, float max)
+{
+    __m256 vmin = _mm256_set1_ps(min), vmax = _mm256_set1_ps(max);
+    size_t i = 0;
+    for (; i + 8 <= x.count; i += 8)
+        _mm256_storeu_ps(x.data + i, _mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(x.data + i), vmin), vmax));
+    clamp_scalar(x, min, max, i);
+}
+
+// Runtime detection of the supported instruction sets
+static SimdLevel detect_simd_level()
+{
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 0);
+    int max_leaf = info[0];
+    __cpuid(info, 1);
+    bool sse2 = (info[3] & (1 << 26)) != 0;
+    bool os_saves_ymm = (info[2] & (1 << 27)) != 0 && (_xgetbv(0) & 6) == 6; // OSXSAVE and the YMM state enabled
+    bool avx2 = false;
+    if (max_leaf >= 7 && os_saves_ymm)
+    {
+        __cpuidex(info, 7, 0);
+        avx2 = (info[1] & (1 << 5)) != 0;
+    }
+#else
+    __builtin_cpu_init();
+    bool sse2 = __builtin_cpu_supports("sse2");
+    bool avx2 = __builtin_cpu_supports("avx2");
+#endif
+    if (avx2)
+        return SimdLevel::AVX2;
+    if (sse2)
+        return SimdLevel::SSE2;
+    return SimdLevel::Scalar;
+}
+#else
+static SimdLevel detect_simd_level()
+{
+    return SimdLevel::Scalar;
+}
+#endif
+
+/////////////////////////////////////////
+// Dispatch
+
+static SimdLevel& current_level()
+{
+    static SimdLevel level = detect_simd_level();
+    return level;
+}
+
+SimdLevel simd_level()
+{
+    return current_level();
+}
+
+void simd_set_level(SimdLevel level)
+{
+    current_level() = std::min(level, detect_simd_level());
+}
+
+const char* simd_level_name(SimdLevel level)
+{
+    switch (level)
+    {
+    case SimdLevel::AVX2: return "AVX2";
+    case SimdLevel::SSE2: return "SSE2";
+    default: return "scalar";
+    }
+}
+
+void simd_axpy(float a, FloatSpan x, FloatSpan y)
+{
+    TINYECS_CHECK(x.count == y.count, "Spans of different size");
+#ifdef TINYECS_SIMD_X86
+    if (x.contiguous() && y.contiguous())
+    {
+        if (current_level() == SimdLevel::AVX2)
+            return axpy_avx2(a, x, y);
+        if (current_level() == SimdLevel::SSE2)
+            return axpy_sse2(a, x, y);
+    }
+#endif
+    axpy_scalar(a, x, y, 0);
+}
+
+void simd_scale(FloatSpan x, float a)
+{
+#ifdef TINYECS_SIMD_X86
+    if (x.contiguous())
+    {
+        if (current_level() == SimdLevel::AVX2)
+            return scale_avx2(x, a);
+        if (current_level() == SimdLevel::SSE2)
+            return scale_sse2(x, a);
+    }
+#endif
+    scale_scalar(x, a, 0);
+}
+
+void simd_clamp(FloatSpan x, float min, float max)
+{
+#ifdef TINYECS_SIMD_X86
+    if (x.contiguous())
+    {
+        if (current_level() == SimdLevel::AVX2)
+            return clamp_avx2(x, min, max);
+        if (current_level() == SimdLevel::SSE2)
+            return clamp_sse2(x, min, max);
+    }
+#endif
+    clamp_scalar(x, min, max, 0);
+}
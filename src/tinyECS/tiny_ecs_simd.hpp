@@ -0,0 +1,100 @@
+#pragma once
+
+#include "tiny_ecs.hpp"
+
+// Vectorized batch kernels over float fields of the components in a container
+// The kernels operate on FloatSpans, e.g., on the walk_speed of all Walks components or on the x and y of all Positions.
+// Contiguous spans are processed with AVX2 or SSE2 instructions, picked at runtime depending on the CPU, and
+// strided spans (one float field of a larger component) fall back to scalar code.
+// Note, compile tiny_ecs_simd.cpp together with tiny_ecs.cpp to use them.
+
+// The floats at data[0], data[stride], data[2 * stride], ...
+struct FloatSpan
+{
+    float* data;
+    size_t count;
+    size_t stride; // in floats, 1 for contiguous floats
+
+    bool contiguous() const { return stride == 1; }
+    float& operator[](size_t i) const { return data[i * stride]; }
+};
+
+// The span of a float field of all components, e.g., float_span(registry.walks, &Walks::walk_speed)
+// The span is contiguous if the component consists of that float only
+template <typename Component>
+FloatSpan float_span(ComponentContainer<Component>& container, float Component::* field)
+{
+    static_assert(sizeof(Component) % sizeof(float) == 0, "The component size must be a multiple of the float size to form a span");
+    if (container.components.empty())
+        return FloatSpan{ nullptr, 0, 1 };
+    return FloatSpan{ &(container.components[0].*field), container.components.size(), sizeof(Component) / sizeof(float) };
+}
+
+// All floats of all components as a single contiguous span, for components that consist of floats only
+// E.g., integrating struct Position { float x, y; } by struct Velocity { float x, y; } is a single axpy over both spans
+// Note, only the size and the trivial copy are checked, the caller ensures that all members are floats
+template <typename Component>
+FloatSpan float_span(ComponentContainer<Component>& container)
+{
+    static_assert(sizeof(Component) % sizeof(float) == 0, "The component size must be a multiple of the float size to form a span");
+    static_assert(std::is_trivially_copyable<Component>::value, "The component must be trivially copyable to be accessed as floats");
+    return FloatSpan{ reinterpret_cast<float*>(container.components.data()), container.components.size() * (sizeof(Component) / sizeof(float)), 1 };
+}
+
+// The instruction sets that the kernels can use
+enum class SimdLevel
+{
+    Scalar,
+    SSE2,
+    AVX2
+};
+
+// The best instruction set supported by this CPU, used by all kernels
+SimdLevel simd_level();
+
+// Overrides the instruction set, e.g., to compare the throughput, levels above the supported one are ignored
+void simd_set_level(SimdLevel level);
+
+const char* simd_level_name(SimdLevel level);
+
+// y[i] += a * x[i], both spans must have the same count, which is checked also in release builds
+void simd_axpy(float a, FloatSpan x, FloatSpan y);
+
+// x[i] *= a
+void simd_scale(FloatSpan x, float a);
+
+// x[i] = min(max(x[i], min), max)
+void simd_clamp(FloatSpan x, float min, float max);
+
+// position[i] += velocity[i] * dt, both spans must have the same count
+// Note, the spans are paired by position, which matches the components of the same entity only if both containers store
+// the same entities in the same order, see the container overload below
+inline void simd_integrate(FloatSpan position, FloatSpan velocity, float dt)
+{
+    simd_axpy(dt, velocity, position);
+}
+
+// Integrates the positions of all entities that have a velocity, the components consist of as many floats each
+// A single axpy over both containers if they store the same entities in the same order, e.g., when they were always
+// inserted and removed together, otherwise the velocity of each position is looked up
+template <typename Position, typename Velocity>
+void simd_integrate(ComponentContainer<Position>& positions, ComponentContainer<Velocity>& velocities, float dt)
+{
+    static_assert(sizeof(Position) == sizeof(Velocity), "Position and velocity must have the same number of floats");
+    if (positions.entities == velocities.entities)
+    {
+        simd_integrate(float_span(positions), float_span(velocities), dt);
+        return;
+    }
+    const size_t floats = sizeof(Position) / sizeof(float);
+    for (size_t i = 0; i < positions.size(); i++)
+    {
+        Velocity* velocity = velocities.try_get(positions.entities[i]);
+        if (!velocity)
+            continue;
+        float* p = reinterpret_cast<float*>(&positions.components[i]);
+        const float* v = reinterpret_cast<const float*>(velocity);
+        for (size_t k = 0; k < floats; k++)
+            p[k] += dt * v[k];
+    }
+}
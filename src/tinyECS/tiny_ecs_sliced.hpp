@@ -0,0 +1,148 @@
+#pragma once
+
+#include "tiny_ecs.hpp"
+#include <chrono>
+#include <unordered_set>
+
+// Time-sliced iteration over a container, e.g., for AI replanning or pathfinding refreshes that don't need to visit every
+// entity every frame
+// Each call visits the next components within a budget of elements or milliseconds and the cursor resumes there in the
+// next frame. A pass visits every enabled component once, also if components are inserted, removed, disabled, or enabled
+// between the calls, since the cursor observes how they move.
+//     SlicedCursor<Walks> replanning(registry.walks); // one per system
+//     replanning.each_for(0.5, [](Entity e, Walks& walks) { ... }); // every frame, 0.5 ms per frame
+// Note, f may remove the component it visits, other structural changes of the container are allowed between the calls
+
+template <typename Component>
+class SlicedCursor : public ContainerObserver
+{
+    ComponentContainer<Component>& container;
+    size_t position = 0; // the components before it were visited in this pass
+    std::vector<Entity> pending; // not yet visited, but moved before the position
+    std::unordered_set<unsigned int> visited_ahead; // already visited, but moved behind the position
+
+    void moved_before(Entity e)
+    {
+        if (!visited_ahead.erase(e))
+            pending.push_back(e);
+    }
+
+    void moved_behind(Entity e)
+    {
+        auto it = std::find(pending.begin(), pending.end(), e);
+        if (it != pending.end())
+            pending.erase(it); // the position reaches it again
+        else
+            visited_ahead.insert(e);
+    }
+
+    // Visits components while budget() allows it, returns true at the end of the pass
+    template <typename F, typename Budget>
+    bool run(F& f, Budget budget)
+    {
+        TINYECS_ZONE("SlicedCursor::run");
+        while (!pending.empty() || position < container.enabled_count)
+        {
+            if (pending.empty() && !visited_ahead.empty() && visited_ahead.erase(container.entities[position]))
+            {
+                position++;
+                continue;
+            }
+            if (!budget())
+                return false;
+            if (!pending.empty())
+            {
+                Entity e = pending.back();
+                pending.pop_back();
+                if (Component* component = container.try_get_enabled(e))
+                    f(e, *component);
+                continue;
+            }
+            // Advance first, such that removing the visited component moves the last one into the visited range
+            size_t i = position++;
+            f(container.entities[i], container.components[i]);
+        }
+        position = 0;
+        visited_ahead.clear();
+        passes++;
+        return true;
+    }
+public:
+    // Number of completed passes
+    size_t passes = 0;
+
+    SlicedCursor(ComponentContainer<Component>& container) : container(container)
+    {
+        container.connect(this);
+    }
+
+    ~SlicedCursor()
+    {
+        container.disconnect(this);
+    }
+
+    SlicedCursor(const SlicedCursor&) = delete;
+    SlicedCursor& operator=(const SlicedCursor&) = delete;
+
+    // Calls f(Entity, Component&) for up to max_count components, returns true if this completed the pass
+    template <typename F>
+    bool each(size_t max_count, F f)
+    {
+        size_t count = 0;
+        return run(f, [&]() { return count++ < max_count; });
+    }
+
+    // Calls f(Entity, Component&) until 'milliseconds' passed, returns true if this completed the pass
+    // The clock is read every 16 components, at least that many are visited per call
+    template <typename F>
+    bool each_for(double milliseconds, F f)
+    {
+        auto end = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double, std::milli>(milliseconds));
+        size_t count = 0;
+        return run(f, [&]() { return ++count % 16 != 0 || std::chrono::steady_clock::now() < end; });
+    }
+
+    // Number of components left in this pass
+    size_t remaining()
+    {
+        size_t ahead = container.enabled_count > position ? container.enabled_count - position : 0;
+        return pending.size() + ahead - std::min(ahead, visited_ahead.size());
+    }
+
+    // Starts a new pass with the first component
+    void restart()
+    {
+        position = 0;
+        pending.clear();
+        visited_ahead.clear();
+    }
+
+    void on_remove(ContainerInterface&, Entity e, unsigned int index) override
+    {
+        auto it = std::find(pending.begin(), pending.end(), e);
+        if (it != pending.end())
+            pending.erase(it);
+        visited_ahead.erase(e);
+
+        // The container moves its last component to the position of the removed one
+        size_t last = container.size() - 1;
+        if (index < position && last >= position)
+            moved_before(container.entities[last]);
+        position = std::min(position, last);
+    }
+
+    void on_swap(ContainerInterface&, unsigned int a, unsigned int b) override
+    {
+        bool a_visited = a < position, b_visited = b < position;
+        if (a_visited == b_visited)
+            return;
+        // The components are already exchanged
+        moved_before(container.entities[a_visited ? a : b]);
+        moved_behind(container.entities[a_visited ? b : a]);
+    }
+
+    void on_clear(ContainerInterface&) override
+    {
+        restart();
+    }
+};
@@ -0,0 +1,560 @@
+#pragma once
+
+#include "tiny_ecs.hpp"
+#include <cmath>
+#include <cstdint>
+
+// Spatial indices over 2D positions stored in a component, e.g., struct Position { float x, y; }
+// They answer radius and box queries with the matching entities instead of scanning the whole container
+// Like the indices in tiny_ecs_index.hpp, they observe the container and are kept up to date on insert(), remove(), patch(), and clear()
+// Note, moving entities by writing to get() directly is not observed, use patch() instead
+
+// A uniform grid that hashes positions to square cells, best when entities are spread evenly
+// The cell size should be in the order of the typical query radius
+template <typename Component>
+class UniformGrid : public ContainerObserver
+{
+private:
+    // An entry of a cell, the position is copied to test it without looking up the component
+    struct Item
+    {
+        Entity entity;
+        float x, y;
+    };
+
+    // Where an entity is stored in the grid
+    struct Slot
+    {
+        uint64_t cell;
+        unsigned int position; // position in map_cell_items[cell]
+    };
+
+    ComponentContainer<Component>& container;
+    float Component::* field_x;
+    float Component::* field_y;
+    float cell_size;
+    float inv_cell_size;
+    std::unordered_map<uint64_t, std::vector<Item>> map_cell_items;
+    std::unordered_map<unsigned int, Slot> map_entity_slot; // the entity is cast to uint to be hashable.
+
+    int cell_coordinate(float v)
+    {
+        return (int)std::floor(v * inv_cell_size);
+    }
+
+    static uint64_t cell_key(int cx, int cy)
+    {
+        return ((uint64_t)(uint32_t)cx << 32) | (uint64_t)(uint32_t)cy;
+    }
+
+    void add(Entity e, float x, float y)
+    {
+        uint64_t cell = cell_key(cell_coordinate(x), cell_coordinate(y));
+        std::vector<Item>& items = map_cell_items[cell];
+        map_entity_slot[e] = Slot{ cell, (unsigned int)items.size() };
+        items.push_back(Item{ e, x, y });
+    }
+
+    void erase(Entity e)
+    {
+        auto slot = map_entity_slot.find(e);
+        auto cell = map_cell_items.find(slot->second.cell);
+        std::vector<Item>& items = cell->second;
+
+        // Move the last item of the cell to the position of e
+        items[slot->second.position] = items.back();
+        map_entity_slot[items.back().entity].position = slot->second.position;
+        items.pop_back();
+        if (items.empty())
+            map_cell_items.erase(cell);
+        map_entity_slot.erase(slot);
+    }
+public:
+    // Indexes the position (container.components[i].*field_x, container.components[i].*field_y)
+    UniformGrid(ComponentContainer<Component>& container, float Component::* field_x, float Component::* field_y, float cell_size)
+        : container(container), field_x(field_x), field_y(field_y), cell_size(cell_size), inv_cell_size(1.f / cell_size)
+    {
+        for (size_t i = 0; i < container.components.size(); i++)
+            add(container.entities[i], container.components[i].*field_x, container.components[i].*field_y);
+        container.connect(this);
+    }
+
+    ~UniformGrid()
+    {
+        container.disconnect(this);
+    }
+
+    UniformGrid(const UniformGrid&) = delete;
+    UniformGrid& operator=(const UniformGrid&) = delete;
+
+    // Calls f(Entity) for all entities with min_x <= x <= max_x and min_y <= y <= max_y
+    template<typename F>
+    void each_in_box(float min_x, float min_y, float max_x, float max_y, F f)
+    {
+        int cx_end = cell_coordinate(max_x), cy_end = cell_coordinate(max_y);
+        for (int cx = cell_coordinate(min_x); cx <= cx_end; cx++)
+            for (int cy = cell_coordinate(min_y); cy <= cy_end; cy++)
+            {
+                auto cell = map_cell_items.find(cell_key(cx, cy));
+                if (cell == map_cell_items.end())
+                    continue;
+                for (const Item& item : cell->second)
+                    if (item.x >= min_x && item.x <= max_x && item.y >= min_y && item.y <= max_y)
+                        f(item.entity);
+            }
+    }
+
+    // Calls f(Entity) for all entities within distance radius of (x, y)
+    template<typename F>
+    void each_in_radius(float x, float y, float radius, F f)
+    {
+        float radius_sq = radius * radius;
+        int cx_end = cell_coordinate(x + radius), cy_end = cell_coordinate(y + radius);
+        for (int cx = cell_coordinate(x - radius); cx <= cx_end; cx++)
+            for (int cy = cell_coordinate(y - radius); cy <= cy_end; cy++)
+            {
+                auto cell = map_cell_items.find(cell_key(cx, cy));
+                if (cell == map_cell_items.end())
+                    continue;
+                for (const Item& item : cell->second)
+                {
+                    float dx = item.x - x, dy = item.y - y;
+                    if (dx * dx + dy * dy <= radius_sq)
+                        f(item.entity);
+                }
+            }
+    }
+
+    // Appends all entities inside the box to result
+    void query_box(float min_x, float min_y, float max_x, float max_y, std::vector<Entity>& result)
+    {
+        each_in_box(min_x, min_y, max_x, max_y, [&result](Entity e) { result.push_back(e); });
+    }
+
+    // Appends all entities within distance radius of (x, y) to result
+    void query_radius(float x, float y, float radius, std::vector<Entity>& result)
+    {
+        each_in_radius(x, y, radius, [&result](Entity e) { result.push_back(e); });
+    }
+
+    // Report the number of indexed entities
+    size_t size()
+    {
+        return map_entity_slot.size();
+    }
+
+    void on_insert(ContainerInterface&, Entity e, unsigned int index)
+    {
+        add(e, container.components[index].*field_x, container.components[index].*field_y);
+    }
+
+    void on_remove(ContainerInterface&, Entity e, unsigned int)
+    {
+        erase(e);
+    }
+
+    void on_patch(ContainerInterface&, Entity e, unsigned int index)
+    {
+        float x = container.components[index].*field_x;
+        float y = container.components[index].*field_y;
+        Slot& slot = map_entity_slot[e];
+        if (slot.cell == cell_key(cell_coordinate(x), cell_coordinate(y)))
+        {
+            // Still in the same cell, only update the copy of the position
+            Item& item = map_cell_items[slot.cell][slot.position];
+            item.x = x;
+            item.y = y;
+            return;
+        }
+        erase(e);
+        add(e, x, y);
+    }
+
+    void on_clear(ContainerInterface&)
+    {
+        map_cell_items.clear();
+        map_entity_slot.clear();
+    }
+};
+
+// A dynamic bounding volume hierarchy (AABB tree), best when entities are clustered or the query sizes vary a lot
+// Every entity is a leaf with a box enlarged by 'margin', small movements within the margin don't change the tree
+// The tree is kept balanced with rotations, following the dynamic tree of Box2D
+template <typename Component>
+class AABBTree : public ContainerObserver
+{
+private:
+    static const int null_node = -1;
+
+    struct Node
+    {
+        float min_x, min_y, max_x, max_y; // the (enlarged) bounding box
+        float x, y; // the exact position, only for leaves
+        int parent; // also used as the next free node in the free list
+        int child1, child2; // null_node for leaves
+        int height; // leaves have height 0, free nodes -1
+        unsigned int entity; // only for leaves, the entity is stored as uint since nodes are default constructed
+
+        bool is_leaf() const { return child1 == null_node; }
+    };
+
+    ComponentContainer<Component>& container;
+    float Component::* field_x;
+    float Component::* field_y;
+    float margin;
+    std::vector<Node> nodes;
+    int root = null_node;
+    int free_list = null_node;
+    std::unordered_map<unsigned int, int> map_entity_leaf; // the entity is cast to uint to be hashable.
+    std::vector<int> stack; // traversal stack kept to avoid re-allocation
+
+    // The cost heuristic of the tree, the perimeter works better than the area for flat and point-like boxes
+    static float perimeter(float min_x, float min_y, float max_x, float max_y)
+    {
+        return 2.f * ((max_x - min_x) + (max_y - min_y));
+    }
+
+    static float combined_perimeter(const Node& a, const Node& b)
+    {
+        return perimeter(std::min(a.min_x, b.min_x), std::min(a.min_y, b.min_y), std::max(a.max_x, b.max_x), std::max(a.max_y, b.max_y));
+    }
+
+    void fit_children(Node& node)
+    {
+        const Node& a = nodes[node.child1];
+        const Node& b = nodes[node.child2];
+        node.min_x = std::min(a.min_x, b.min_x);
+        node.min_y = std::min(a.min_y, b.min_y);
+        node.max_x = std::max(a.max_x, b.max_x);
+        node.max_y = std::max(a.max_y, b.max_y);
+        node.height = 1 + std::max(a.height, b.height);
+    }
+
+    int allocate_node()
+    {
+        if (free_list == null_node)
+        {
+            nodes.push_back(Node());
+            free_list = (int)nodes.size() - 1;
+            nodes[free_list].parent = null_node;
+        }
+        int id = free_list;
+        free_list = nodes[id].parent;
+        Node& node = nodes[id];
+        node.parent = node.child1 = node.child2 = null_node;
+        node.height = 0;
+        return id;
+    }
+
+    void free_node(int id)
+    {
+        nodes[id].parent = free_list;
+        nodes[id].height = -1;
+        free_list = id;
+    }
+
+    void set_leaf_box(Node& leaf, float x, float y)
+    {
+        leaf.x = x;
+        leaf.y = y;
+        leaf.min_x = x - margin;
+        leaf.min_y = y - margin;
+        leaf.max_x = x + margin;
+        leaf.max_y = y + margin;
+    }
+
+    void insert_leaf(int leaf)
+    {
+        if (root == null_node)
+        {
+            root = leaf;
+            nodes[root].parent = null_node;
+            return;
+        }
+
+        // Find the best sibling by descending towards the child with the lower cost of enlargement
+        int index = root;
+        while (!nodes[index].is_leaf())
+        {
+            const Node& node = nodes[index];
+            float node_perimeter = perimeter(node.min_x, node.min_y, node.max_x, node.max_y);
+            float combined = combined_perimeter(node, nodes[leaf]);
+            float cost = 2.f * combined; // cost of creating a new parent for this node and the new leaf
+            float inheritance_cost = 2.f * (combined - node_perimeter); // minimum cost of pushing the leaf further down
+
+            float cost1 = descend_cost(node.child1, leaf) + inheritance_cost;
+            float cost2 = descend_cost(node.child2, leaf) + inheritance_cost;
+            if (cost < cost1 && cost < cost2)
+                break;
+            index = cost1 < cost2 ? node.child1 : node.child2;
+        }
+        int sibling = index;
+
+        // Create a new parent for the sibling and the leaf
+        int old_parent = nodes[sibling].parent;
+        int new_parent = allocate_node();
+        nodes[new_parent].parent = old_parent;
+        nodes[new_parent].child1 = sibling;
+        nodes[new_parent].child2 = leaf;
+        nodes[sibling].parent = new_parent;
+        nodes[leaf].parent = new_parent;
+        if (old_parent == null_node)
+            root = new_parent;
+        else if (nodes[old_parent].child1 == sibling)
+            nodes[old_parent].child1 = new_parent;
+        else
+            nodes[old_parent].child2 = new_parent;
+
+        refit_ancestors(new_parent);
+    }
+
+    float descend_cost(int child, int leaf)
+    {
+        const Node& node = nodes[child];
+        float combined = combined_perimeter(node, nodes[leaf]);
+        if (node.is_leaf())
+            return combined;
+        return combined - perimeter(node.min_x, node.min_y, node.max_x, node.max_y);
+    }
+
+    void remove_leaf(int leaf)
+    {
+        if (leaf == root)
+        {
+            root = null_node;
+            return;
+        }
+
+        // Replace the parent by the sibling
+        int parent = nodes[leaf].parent;
+        int grand_parent = nodes[parent].parent;
+        int sibling = nodes[parent].child1 == leaf ? nodes[parent].child2 : nodes[parent].child1;
+        if (grand_parent == null_node)
+        {
+            root = sibling;
+            nodes[sibling].parent = null_node;
+        }
+        else
+        {
+            if (nodes[grand_parent].child1 == parent)
+                nodes[grand_parent].child1 = sibling;
+            else
+                nodes[grand_parent].child2 = sibling;
+            nodes[sibling].parent = grand_parent;
+            refit_ancestors(grand_parent);
+        }
+        free_node(parent);
+    }
+
+    // Walk up the tree to update the boxes and heights and keep it balanced
+    void refit_ancestors(int index)
+    {
+        while (index != null_node)
+        {
+            index = balance(index);
+            fit_children(nodes[index]);
+            index = nodes[index].parent;
+        }
+    }
+
+    // Performs a left or right rotation if node a is imbalanced, returns the new root of the subtree
+    int balance(int a)
+    {
+        if (nodes[a].is_leaf() || nodes[a].height < 2)
+            return a;
+
+        int b = nodes[a].child1;
+        int c = nodes[a].child2;
+        int difference = nodes[c].height - nodes[b].height;
+        if (difference > 1)
+            return rotate(a, c);
+        if (difference < -1)
+            return rotate(a, b);
+        return a;
+    }
+
+    // Promotes the higher child 'up' of a
+    int rotate(int a, int up)
+    {
+        int f = nodes[up].child1;
+        int g = nodes[up].child2;
+
+        // Swap a and up
+        nodes[up].child1 = a;
+        nodes[up].parent = nodes[a].parent;
+        nodes[a].parent = up;
+        if (nodes[up].parent == null_node)
+            root = up;
+        else if (nodes[nodes[up].parent].child1 == a)
+            nodes[nodes[up].parent].child1 = up;
+        else
+            nodes[nodes[up].parent].child2 = up;
+
+        // Keep the higher grandchild under 'up' and give the lower one to a
+        int keep = nodes[f].height > nodes[g].height ? f : g;
+        int give = keep == f ? g : f;
+        nodes[up].child2 = keep;
+        if (nodes[a].child1 == up)
+            nodes[a].child1 = give;
+        else
+            nodes[a].child2 = give;
+        nodes[give].parent = a;
+
+        fit_children(nodes[a]);
+        fit_children(nodes[up]);
+        return up;
+    }
+
+    void add(Entity e, float x, float y)
+    {
+        int leaf = allocate_node();
+        nodes[leaf].entity = e;
+        set_leaf_box(nodes[leaf], x, y);
+        insert_leaf(leaf);
+        map_entity_leaf[e] = leaf;
+    }
+
+    void erase(Entity e)
+    {
+        auto it = map_entity_leaf.find(e);
+        remove_leaf(it->second);
+        free_node(it->second);
+        map_entity_leaf.erase(it);
+    }
+public:
+    // Indexes the position (container.components[i].*field_x, container.components[i].*field_y)
+    AABBTree(ComponentContainer<Component>& container, float Component::* field_x, float Component::* field_y, float margin = 1.f)
+        : container(container), field_x(field_x), field_y(field_y), margin(margin)
+    {
+        for (size_t i = 0; i < container.components.size(); i++)
+            add(container.entities[i], container.components[i].*field_x, container.components[i].*field_y);
+        container.connect(this);
+    }
+
+    ~AABBTree()
+    {
+        container.disconnect(this);
+    }
+
+    AABBTree(const AABBTree&) = delete;
+    AABBTree& operator=(const AABBTree&) = delete;
+
+    // Calls f(Entity) for all entities with min_x <= x <= max_x and min_y <= y <= max_y
+    template<typename F>
+    void each_in_box(float min_x, float min_y, float max_x, float max_y, F f)
+    {
+        if (root == null_node)
+            return;
+        stack.clear();
+        stack.push_back(root);
+        while (!stack.empty())
+        {
+            const Node& node = nodes[stack.back()];
+            stack.pop_back();
+            if (node.max_x < min_x || node.min_x > max_x || node.max_y < min_y || node.min_y > max_y)
+                continue;
+            if (node.is_leaf())
+            {
+                if (node.x >= min_x && node.x <= max_x && node.y >= min_y && node.y <= max_y)
+                    f(Entity::from_id(node.entity));
+            }
+            else
+            {
+                stack.push_back(node.child1);
+                stack.push_back(node.child2);
+            }
+        }
+    }
+
+    // Calls f(Entity) for all entities within distance radius of (x, y)
+    template<typename F>
+    void each_in_radius(float x, float y, float radius, F f)
+    {
+        float radius_sq = radius * radius;
+        if (root == null_node)
+            return;
+        stack.clear();
+        stack.push_back(root);
+        while (!stack.empty())
+        {
+            const Node& node = nodes[stack.back()];
+            stack.pop_back();
+            // Distance from the query center to the box
+            float dx = std::max(0.f, std::max(node.min_x - x, x - node.max_x));
+            float dy = std::max(0.f, std::max(node.min_y - y, y - node.max_y));
+            if (dx * dx + dy * dy > radius_sq)
+                continue;
+            if (node.is_leaf())
+            {
+                float px = node.x - x, py = node.y - y;
+                if (px * px + py * py <= radius_sq)
+                    f(Entity::from_id(node.entity));
+            }
+            else
+            {
+                stack.push_back(node.child1);
+                stack.push_back(node.child2);
+            }
+        }
+    }
+
+    // Appends all entities inside the box to result
+    void query_box(float min_x, float min_y, float max_x, float max_y, std::vector<Entity>& result)
+    {
+        each_in_box(min_x, min_y, max_x, max_y, [&result](Entity e) { result.push_back(e); });
+    }
+
+    // Appends all entities within distance radius of (x, y) to result
+    void query_radius(float x, float y, float radius, std::vector<Entity>& result)
+    {
+        each_in_radius(x, y, radius, [&result](Entity e) { result.push_back(e); });
+    }
+
+    // Report the number of indexed entities
+    size_t size()
+    {
+        return map_entity_leaf.size();
+    }
+
+    // Report the height of the tree, an indicator of its balance
+    int height()
+    {
+        return root == null_node ? 0 : nodes[root].height;
+    }
+
+    void on_insert(ContainerInterface&, Entity e, unsigned int index)
+    {
+        add(e, container.components[index].*field_x, container.components[index].*field_y);
+    }
+
+    void on_remove(ContainerInterface&, Entity e, unsigned int)
+    {
+        erase(e);
+    }
+
+    void on_patch(ContainerInterface&, Entity e, unsigned int index)
+    {
+        float x = container.components[index].*field_x;
+        float y = container.components[index].*field_y;
+        int leaf = map_entity_leaf[e];
+        Node& node = nodes[leaf];
+        if (x >= node.min_x && x <= node.max_x && y >= node.min_y && y <= node.max_y)
+        {
+            // Still inside the enlarged box, the tree stays valid
+            node.x = x;
+            node.y = y;
+            return;
+        }
+        remove_leaf(leaf);
+        set_leaf_box(nodes[leaf], x, y);
+        insert_leaf(leaf);
+    }
+
+    void on_clear(ContainerInterface&)
+    {
+        nodes.clear();
+        root = null_node;
+        free_list = null_node;
+        map_entity_leaf.clear();
+    }
+};
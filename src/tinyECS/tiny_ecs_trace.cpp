@@ -0,0 +1,122 @@
+// internal
+#include "tiny_ecs_trace.hpp"
+#include <memory>
+#include <mutex>
+#include <cstdio>
+#include <algorithm>
+
+// All buffers, guarded by the mutex, which is only locked when a thread records its first zone and on export
+static std::mutex& trace_mutex()
+{
+    static std::mutex mutex;
+    return mutex;
+}
+
+static std::vector<std::unique_ptr<TraceBuffer>>& trace_buffers()
+{
+    static std::vector<std::unique_ptr<TraceBuffer>> buffers;
+    return buffers;
+}
+
+static size_t trace_capacity = 1 << 16;
+
+// The time stamp and clock at the first zone, to convert time stamps to microseconds
+struct TraceClock
+{
+    uint64_t stamp;
+    std::chrono::steady_clock::time_point time;
+};
+
+static const TraceClock& trace_origin()
+{
+    static const TraceClock origin = { trace_now(), std::chrono::steady_clock::now() };
+    return origin;
+}
+
+TraceBuffer* trace_create_thread_buffer()
+{
+    trace_origin();
+    std::lock_guard<std::mutex> lock(trace_mutex());
+    std::vector<std::unique_ptr<TraceBuffer>>& buffers = trace_buffers();
+    buffers.emplace_back(new TraceBuffer(trace_capacity, (unsigned int)buffers.size()));
+    return buffers.back().get();
+}
+
+void trace_set_capacity(size_t zones_per_thread)
+{
+    size_t capacity = 1;
+    while (capacity < zones_per_thread)
+        capacity *= 2;
+    std::lock_guard<std::mutex> lock(trace_mutex());
+    trace_capacity = capacity;
+}
+
+// Writes s as a JSON string, zone names may contain quotes, backslashes, or control characters
+static void trace_write_string(FILE* file, const char* s)
+{
+    fputc('"', file);
+    for (; *s; s++)
+    {
+        unsigned char c = (unsigned char)*s;
+        if (c == '"' || c == '\\')
+            fprintf(file, "\\%c", c);
+        else if (c < 0x20)
+            fprintf(file, "\\u%04x", c);
+        else
+            fputc(c, file);
+    }
+    fputc('"', file);
+}
+
+bool trace_export_chrome(const char* path)
+{
+    FILE* file = fopen(path, "w");
+    if (!file)
+        return false;
+
+    // Time stamps per microsecond, measured since the first zone
+    const TraceClock& origin = trace_origin();
+    uint64_t stamp = trace_now();
+    double microseconds = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - origin.time).count();
+    double stamps_per_microsecond = stamp > origin.stamp && microseconds > 0 ? (stamp - origin.stamp) / microseconds : 1.0;
+
+    fprintf(file, "{\"traceEvents\":[\n");
+    bool first = true;
+    std::lock_guard<std::mutex> lock(trace_mutex());
+    std::vector<TraceEvent> events;
+    for (const std::unique_ptr<TraceBuffer>& buffer : trace_buffers())
+    {
+        // Copy the zones, then drop those that the thread may have overwritten meanwhile
+        uint64_t capacity = buffer->events.size();
+        uint64_t head = buffer->head.load(std::memory_order_acquire);
+        uint64_t begin = head > capacity ? head - capacity : 0;
+        events.clear();
+        for (uint64_t i = begin; i < head; i++)
+            events.push_back(buffer->read(i));
+        // Orders the copies before the second head load, which then counts every zone whose fields were copied
+        std::atomic_thread_fence(std::memory_order_acquire);
+        uint64_t head_after = buffer->head.load(std::memory_order_relaxed);
+        uint64_t valid = head_after + 1 > capacity ? head_after + 1 - capacity : 0;
+
+        for (uint64_t i = std::max(begin, valid); i < head; i++)
+        {
+            const TraceEvent& event = events[i - begin];
+            double ts = (double)(int64_t)(event.begin - origin.stamp) / stamps_per_microsecond;
+            double dur = (double)(event.end - event.begin) / stamps_per_microsecond;
+            fprintf(file, "%s{\"name\":", first ? "" : ",\n");
+            trace_write_string(file, event.name);
+            fprintf(file, ",\"cat\":\"tinyECS\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+                buffer->thread_index, ts, dur);
+            first = false;
+        }
+    }
+    fprintf(file, "\n],\"displayTimeUnit\":\"ns\"}\n");
+    return fclose(file) == 0;
+}
+
+void trace_clear()
+{
+    std::lock_guard<std::mutex> lock(trace_mutex());
+    for (const std::unique_ptr<TraceBuffer>& buffer : trace_buffers())
+        buffer->head.store(0, std::memory_order_release);
+}